@@ -0,0 +1,189 @@
+#include "checkpoint.h"
+#include "crc.h"
+
+#ifndef __AVR__
+#include <stdio.h>
+#include <string.h>
+#endif
+
+//Bytes read at a time while checking a slot's CRC
+#define CHECKPOINT_CHUNK 16
+
+//Sets up a store over size bytes reached through read and write
+void initCheckpointStore(CheckpointStore *store, unsigned int size, CheckpointRead read, CheckpointWrite write,
+                         void *context) {
+    store->size = size;
+    store->read = read;
+    store->write = write;
+    store->context = context;
+    store->nextSlot = 0;
+    store->sequence = 0;
+    store->pendingState = 0x0;
+}
+
+//Returns how many checkpoints of a length byte record the store rotates over
+unsigned int checkpointSlots(const CheckpointStore *store, unsigned char length) {
+    return store->size / (CHECKPOINT_HEADER + length + CHECKPOINT_TRAILER);
+}
+
+//Returns the CRC-16 over header and record of the slot at address, read back from the store
+static unsigned short slotCrc(CheckpointStore *store, unsigned int address, unsigned int length) {
+    unsigned char chunk[CHECKPOINT_CHUNK];
+    unsigned short crc = CRC16_INIT;
+    while (length > 0) {
+        unsigned int count = length < CHECKPOINT_CHUNK ? length : CHECKPOINT_CHUNK;
+        store->read(address, chunk, count, store->context);
+        crc = crc16(crc, chunk, count);
+        address += count;
+        length -= count;
+    }
+    return crc;
+}
+
+//Copies the newest intact checkpoint of a length byte record into state and returns TRUE
+//Only headers and CRCs are read until the newest slot is known, then its record is read once
+Bool loadCheckpoint(CheckpointStore *store, void *state, unsigned char length) {
+    unsigned int slotSize = CHECKPOINT_HEADER + length + CHECKPOINT_TRAILER;
+    unsigned int slots = checkpointSlots(store, length);
+    Bool found = FALSE;
+    unsigned int newestSlot = 0;
+    unsigned short newestSequence = 0;
+    for (unsigned int slot = 0; slot < slots; slot++) {
+        unsigned int address = slot * slotSize;
+        unsigned char header[CHECKPOINT_HEADER];
+        unsigned char trailer[CHECKPOINT_TRAILER];
+        store->read(address, header, CHECKPOINT_HEADER, store->context);
+        if (header[2] != length) { //Erased, or written by a build with a different record
+            continue;
+        }
+        store->read(address + CHECKPOINT_HEADER + length, trailer, CHECKPOINT_TRAILER, store->context);
+        unsigned short crc = (unsigned short) ((trailer[0] << 8) | trailer[1]);
+        if (slotCrc(store, address, CHECKPOINT_HEADER + length) != crc) { //Torn or never written
+            continue;
+        }
+        unsigned short sequence = (unsigned short) ((header[0] << 8) | header[1]);
+        //Sequence numbers wrap, so newer means less than half the number space ahead
+        if (!found || (unsigned short) (sequence - newestSequence) < 0x8000U) {
+            found = TRUE;
+            newestSlot = slot;
+            newestSequence = sequence;
+        }
+    }
+    if (!found) {
+        store->nextSlot = 0;
+        store->sequence = 0;
+        return FALSE;
+    }
+    store->read(newestSlot * slotSize + CHECKPOINT_HEADER, state, length, store->context);
+    store->nextSlot = (newestSlot + 1) % slots;
+    store->sequence = newestSequence;
+    return TRUE;
+}
+
+//Writes state as the newest checkpoint
+void saveCheckpoint(CheckpointStore *store, const void *state, unsigned char length) {
+    beginCheckpoint(store, state, length);
+    continueCheckpoint(store, CHECKPOINT_HEADER + length + CHECKPOINT_TRAILER);
+}
+
+//Starts writing state as the newest checkpoint, state must stay unchanged until continueCheckpoint finishes it
+void beginCheckpoint(CheckpointStore *store, const void *state, unsigned char length) {
+    unsigned int slots = checkpointSlots(store, length);
+    if (slots == 0) {
+        store->pendingState = 0x0;
+        return;
+    }
+    unsigned short sequence = (unsigned short) (store->sequence + 1);
+    store->pendingHeader[0] = (unsigned char) (sequence >> 8);
+    store->pendingHeader[1] = (unsigned char) (sequence & 0xFF);
+    store->pendingHeader[2] = length;
+    unsigned short crc = crc16(crc16(CRC16_INIT, store->pendingHeader, CHECKPOINT_HEADER),
+                               (const unsigned char *) state, length);
+    store->pendingTrailer[0] = (unsigned char) (crc >> 8);
+    store->pendingTrailer[1] = (unsigned char) (crc & 0xFF);
+    store->pendingState = (const unsigned char *) state;
+    store->pendingLength = length;
+    store->pendingAddress = (store->nextSlot % slots) * (CHECKPOINT_HEADER + length + CHECKPOINT_TRAILER);
+    store->pendingWritten = 0;
+}
+
+//Writes up to maxBytes more of the save begun by beginCheckpoint, returns TRUE once it is complete
+//The slot is written in order and the CRC goes last, so it is only valid once it is completely written. The new
+//sequence number in the header already breaks the old CRC, so a reset part way through leaves a slot that fails
+//its check
+Bool continueCheckpoint(CheckpointStore *store, unsigned int maxBytes) {
+    if (store->pendingState == 0x0) {
+        return TRUE;
+    }
+    unsigned int length = store->pendingLength;
+    unsigned int slotSize = CHECKPOINT_HEADER + length + CHECKPOINT_TRAILER;
+    while (maxBytes > 0 && store->pendingWritten < slotSize) {
+        unsigned int position = store->pendingWritten;
+        const unsigned char *source;
+        unsigned int available;
+        if (position < CHECKPOINT_HEADER) {
+            source = &store->pendingHeader[position];
+            available = CHECKPOINT_HEADER - position;
+        } else if (position < CHECKPOINT_HEADER + length) {
+            source = &store->pendingState[position - CHECKPOINT_HEADER];
+            available = CHECKPOINT_HEADER + length - position;
+        } else {
+            source = &store->pendingTrailer[position - CHECKPOINT_HEADER - length];
+            available = slotSize - position;
+        }
+        unsigned int count = available < maxBytes ? available : maxBytes;
+        store->write(store->pendingAddress + position, source, count, store->context);
+        store->pendingWritten += count;
+        maxBytes -= count;
+    }
+    if (store->pendingWritten < slotSize) {
+        return FALSE;
+    }
+    store->pendingState = 0x0;
+    store->nextSlot = (store->nextSlot + 1) % checkpointSlots(store, (unsigned char) length);
+    store->sequence = (unsigned short) ((store->pendingHeader[0] << 8) | store->pendingHeader[1]);
+    return TRUE;
+}
+
+//Returns TRUE while a save begun by beginCheckpoint is not complete
+Bool checkpointPending(const CheckpointStore *store) {
+    return store->pendingState != 0x0 ? TRUE : FALSE;
+}
+
+#ifndef __AVR__
+//Reads from the file behind a file store
+static void fileRead(unsigned int address, void *buffer, unsigned int length, void *context) {
+    FILE *file = (FILE *) context;
+    fseek(file, (long) address, SEEK_SET);
+    if (fread(buffer, 1, length, file) != length) {
+        memset(buffer, 0xFF, length);
+    }
+}
+
+//Writes to the file behind a file store and flushes, the way an EEPROM write is done when it returns
+static void fileWrite(unsigned int address, const void *buffer, unsigned int length, void *context) {
+    FILE *file = (FILE *) context;
+    fseek(file, (long) address, SEEK_SET);
+    fwrite(buffer, 1, length, file);
+    fflush(file);
+}
+
+//Sets up a store kept in a file, creating it as erased EEPROM when it is missing or short. Returns FALSE on failure
+Bool openFileCheckpointStore(CheckpointStore *store, const char *path, unsigned int size) {
+    FILE *file = fopen(path, "r+b");
+    if (file == NULL) {
+        file = fopen(path, "w+b");
+        if (file == NULL) {
+            return FALSE;
+        }
+    }
+    fseek(file, 0, SEEK_END);
+    long existing = ftell(file);
+    for (long i = existing < 0 ? 0 : existing; i < (long) size; i++) {
+        fputc(0xFF, file);
+    }
+    fflush(file);
+    initCheckpointStore(store, size, &fileRead, &fileWrite, (void *) file);
+    return TRUE;
+}
+#endif
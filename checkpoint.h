@@ -0,0 +1,79 @@
+//Wear leveled checkpoints of a fixed size state record in EEPROM, or in a file standing in for it on the host
+//The store is split into slots of a header, the record and a CRC-16. Every save goes to the slot after the newest,
+//so the writes rotate over the whole store and a save cut short by a reset leaves the previous checkpoint intact
+//A save can also be spread over several calls a few bytes at a time, for stores as slow as EEPROM
+//Plain C with no Arduino dependencies
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Sequence number and record length ahead of the record in every slot
+#define CHECKPOINT_HEADER 3
+//CRC-16 after the record
+#define CHECKPOINT_TRAILER 2
+
+//Reads or writes length bytes of the store at address
+typedef void (*CheckpointRead)(unsigned int address, void *buffer, unsigned int length, void *context);
+typedef void (*CheckpointWrite)(unsigned int address, const void *buffer, unsigned int length, void *context);
+
+//Where the checkpoints live and where the next one goes
+struct CheckpointStoreStruct {
+    unsigned int size; //Bytes of storage
+    CheckpointRead read;
+    CheckpointWrite write;
+    void *context;
+    unsigned int nextSlot; //Set by loadCheckpoint
+    unsigned short sequence; //Of the newest checkpoint
+    //A save in progress through continueCheckpoint, pendingState is 0x0 when there is none
+    const unsigned char *pendingState;
+    unsigned char pendingLength;
+    unsigned int pendingAddress; //Of the slot being written
+    unsigned int pendingWritten; //Bytes of the slot written so far
+    unsigned char pendingHeader[CHECKPOINT_HEADER];
+    unsigned char pendingTrailer[CHECKPOINT_TRAILER];
+};
+typedef struct CheckpointStoreStruct CheckpointStore;
+
+//Sets up a store over size bytes reached through read and write
+void initCheckpointStore(CheckpointStore *store, unsigned int size, CheckpointRead read, CheckpointWrite write,
+                         void *context);
+
+//Returns how many checkpoints of a length byte record the store rotates over
+unsigned int checkpointSlots(const CheckpointStore *store, unsigned char length);
+
+//Copies the newest intact checkpoint of a length byte record into state and returns TRUE
+//Returns FALSE and leaves state alone when there is none. Either way the next save goes after the newest slot,
+//so call this once before the first saveCheckpoint
+Bool loadCheckpoint(CheckpointStore *store, void *state, unsigned char length);
+
+//Writes state as the newest checkpoint
+void saveCheckpoint(CheckpointStore *store, const void *state, unsigned char length);
+
+//Starts writing state as the newest checkpoint, state must stay unchanged until continueCheckpoint finishes it
+//A save already in progress is abandoned, its slot is left failing its CRC and is written again
+void beginCheckpoint(CheckpointStore *store, const void *state, unsigned char length);
+
+//Writes up to maxBytes more of the save begun by beginCheckpoint, returns TRUE once it is complete
+//Returns TRUE right away when no save is in progress
+Bool continueCheckpoint(CheckpointStore *store, unsigned int maxBytes);
+
+//Returns TRUE while a save begun by beginCheckpoint is not complete
+Bool checkpointPending(const CheckpointStore *store);
+
+#ifndef __AVR__
+//Sets up a store kept in a file, creating it as erased EEPROM when it is missing or short. Returns FALSE on failure
+//The file stays open for the life of the program
+Bool openFileCheckpointStore(CheckpointStore *store, const char *path, unsigned int size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CHECKPOINT_H
@@ -0,0 +1,148 @@
+//Flies the mission model with periodic checkpoints into a file standing in for the satellite's EEPROM
+//Run it again on the same file to resume where the last run stopped, the way the satellite resumes after a reset
+//Usage: checkpoint_sim [-f eeprom_file] [-z eeprom_bytes] [-n periods] [-c periods_per_checkpoint] [-s seed] [-v]
+//       -v flies the same periods again without stopping and checks the resumed mission ends in the same state
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "mission.h"
+#include "crc.h"
+#include "hosttools.h"
+
+//EEPROM of the ATmega328P on the Uno
+#define UNO_EEPROM_BYTES 1024
+
+//Times each byte of the store has been written this run
+unsigned long *byteWrites;
+
+//Read and write of the file store, kept so writes can be counted on their way through
+CheckpointRead fileRead;
+CheckpointWrite fileWrite;
+
+//Counts a write to every byte it covers and passes it on to the file
+void countingWrite(unsigned int address, const void *buffer, unsigned int length, void *context) {
+    for (unsigned int i = 0; i < length; i++) {
+        byteWrites[address + i]++;
+    }
+    fileWrite(address, buffer, length, context);
+}
+
+//Flies periods periods of mission, saving a checkpoint every interval periods when a store is given
+void fly(MissionState *mission, long periods, long interval, CheckpointStore *store) {
+    for (long i = 0; i < periods; i++) {
+        stepMission(mission);
+        if (store != NULL && interval > 0 && mission->periods % interval == 0) {
+            unsigned char snapshot[MISSION_SNAPSHOT_SIZE];
+            encodeMissionSnapshot(mission, snapshot);
+            saveCheckpoint(store, snapshot, MISSION_SNAPSHOT_SIZE);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = "checkpoint.eeprom";
+    unsigned int size = UNO_EEPROM_BYTES;
+    long periods = 1000;
+    long interval = 12;
+    long seed = 1000;
+    int verify = 0;
+    int option;
+    while ((option = getopt(argc, argv, "f:z:n:c:s:v")) != -1) {
+        switch (option) {
+            case 'f':
+                path = optarg;
+                break;
+            case 'z':
+                size = (unsigned int) atol(optarg);
+                break;
+            case 'n':
+                periods = atol(optarg);
+                break;
+            case 'c':
+                interval = atol(optarg);
+                break;
+            case 's':
+                seed = atol(optarg);
+                break;
+            case 'v':
+                verify = 1;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f eeprom_file] [-z eeprom_bytes] [-n periods] [-c periods_per_checkpoint]"
+                                " [-s seed] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!crcSelfTest()) {
+        fprintf(stderr, "CRC self test failed\n");
+        return 1;
+    }
+    CheckpointStore store;
+    if (!openFileCheckpointStore(&store, path, size)) {
+        perror(path);
+        return 1;
+    }
+    byteWrites = calloc(size, sizeof(unsigned long));
+    if (byteWrites == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    fileRead = store.read;
+    fileWrite = store.write;
+    store.write = &countingWrite;
+
+    MissionState mission;
+    unsigned char snapshot[MISSION_SNAPSHOT_SIZE];
+    double start = seconds();
+    Bool resumed = loadCheckpoint(&store, snapshot, MISSION_SNAPSHOT_SIZE) && decodeMissionSnapshot(snapshot, &mission);
+    double restoreTime = seconds() - start;
+    if (resumed) {
+        printf("resumed seq=%u period=%lu in %.1fus\n", store.sequence, mission.periods, restoreTime * 1e6);
+    } else {
+        initMission(&mission, (int32_t) seed);
+        printf("no checkpoint in %s, new mission with seed %ld\n", path, seed);
+    }
+
+    //What an uninterrupted run from the same start must end in
+    MissionState expected = mission;
+    fly(&mission, periods, interval, &store);
+
+    unsigned long maxWrites = 0;
+    unsigned long bytesWritten = 0;
+    for (unsigned int i = 0; i < size; i++) {
+        bytesWritten += byteWrites[i];
+        if (byteWrites[i] > maxWrites) {
+            maxWrites = byteWrites[i];
+        }
+    }
+    printf("period=%lu battery=%u fuel=%u seq=%u\n", mission.periods, mission.batteryLevel, mission.fuelLevel,
+           store.sequence);
+    printf("slots=%u bytes written=%lu most writes to one byte=%lu\n", checkpointSlots(&store, MISSION_SNAPSHOT_SIZE),
+           bytesWritten, maxWrites);
+
+    if (verify) {
+        //Stops part way, resumes from the file, and checks the mission carries on as if it never stopped
+        fly(&expected, periods, 0, NULL);
+        MissionState resumedMission;
+        CheckpointStore reopened = store;
+        if (!loadCheckpoint(&reopened, snapshot, MISSION_SNAPSHOT_SIZE) ||
+            !decodeMissionSnapshot(snapshot, &resumedMission)) {
+            fprintf(stderr, "no checkpoint to verify against\n");
+            return 1;
+        }
+        fly(&resumedMission, (long) (expected.periods - resumedMission.periods), 0, NULL);
+        unsigned char expectedSnapshot[MISSION_SNAPSHOT_SIZE];
+        encodeMissionSnapshot(&expected, expectedSnapshot);
+        encodeMissionSnapshot(&resumedMission, snapshot);
+        if (memcmp(snapshot, expectedSnapshot, MISSION_SNAPSHOT_SIZE) != 0) {
+            fprintf(stderr, "resumed mission diverged from the uninterrupted one\n");
+            return 1;
+        }
+        printf("resume from seq=%u matches the uninterrupted mission\n", reopened.sequence);
+    }
+    free(byteWrites);
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "crc.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define readTable16(table, index) pgm_read_word(&(table)[index])
+#define readTable32(table, index) pgm_read_dword(&(table)[index])
+#else
+#define PROGMEM
+#define readTable16(table, index) ((table)[index])
+#define readTable32(table, index) ((table)[index])
+#endif
+
+//CRC-16 of each 4 bit value shifted to the top of the register
+static const unsigned short crc16NibbleTable[16] PROGMEM = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+//Reflected CRC-32 of each 4 bit value
+static const uint32_t crc32NibbleTable[16] PROGMEM = {
+        0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+        0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+
+//Adds one byte to a CRC-16
+unsigned short crc16Update(unsigned short crc, unsigned char byte) {
+    crc = (unsigned short) ((crc << 4) ^ readTable16(crc16NibbleTable, (crc >> 12) ^ (byte >> 4)));
+    crc = (unsigned short) ((crc << 4) ^ readTable16(crc16NibbleTable, (crc >> 12) ^ (byte & 0x0F)));
+    return crc;
+}
+
+//Adds length bytes to a CRC-16 with the nibble table
+unsigned short crc16Nibble(unsigned short crc, const unsigned char data[], unsigned long length) {
+    for (unsigned long i = 0; i < length; i++) {
+        crc = crc16Update(crc, data[i]);
+    }
+    return crc;
+}
+
+//Adds length bytes to a CRC-32 with the nibble table
+uint32_t crc32Nibble(uint32_t crc, const unsigned char data[], unsigned long length) {
+    for (unsigned long i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ readTable32(crc32NibbleTable, crc & 0x0F);
+        crc = (crc >> 4) ^ readTable32(crc32NibbleTable, crc & 0x0F);
+    }
+    return crc;
+}
+
+//Returns the CRC-32 to transmit or compare from a running CRC-32
+uint32_t crc32Final(uint32_t crc) {
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+#ifndef __AVR__
+//Slice-by-8 tables, entry k of table n is the CRC of byte k followed by n zero bytes
+static unsigned short crc16Tables[8][256];
+static uint32_t crc32Tables[8][256];
+static int tablesReady = 0;
+
+//Fills the slice-by-8 tables from the nibble tables
+static void buildTables(void) {
+    for (int i = 0; i < 256; i++) {
+        unsigned char byte = (unsigned char) i;
+        crc16Tables[0][i] = crc16Nibble(0, &byte, 1);
+        crc32Tables[0][i] = crc32Nibble(0, &byte, 1);
+    }
+    for (int n = 1; n < 8; n++) {
+        for (int i = 0; i < 256; i++) {
+            unsigned short previous16 = crc16Tables[n - 1][i];
+            crc16Tables[n][i] = (unsigned short) ((previous16 << 8) ^ crc16Tables[0][previous16 >> 8]);
+            uint32_t previous32 = crc32Tables[n - 1][i];
+            crc32Tables[n][i] = (previous32 >> 8) ^ crc32Tables[0][previous32 & 0xFF];
+        }
+    }
+    tablesReady = 1;
+}
+
+//Adds length bytes to a CRC-16 eight bytes at a time
+unsigned short crc16SliceBy8(unsigned short crc, const unsigned char data[], unsigned long length) {
+    if (!tablesReady) {
+        buildTables();
+    }
+    unsigned long i = 0;
+    for (; i + 8 <= length; i += 8) {
+        const unsigned char *p = data + i;
+        crc = (unsigned short) (crc16Tables[7][(crc >> 8) ^ p[0]] ^ crc16Tables[6][(crc & 0xFF) ^ p[1]] ^
+                                crc16Tables[5][p[2]] ^ crc16Tables[4][p[3]] ^ crc16Tables[3][p[4]] ^
+                                crc16Tables[2][p[5]] ^ crc16Tables[1][p[6]] ^ crc16Tables[0][p[7]]);
+    }
+    for (; i < length; i++) {
+        crc = (unsigned short) ((crc << 8) ^ crc16Tables[0][(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+//Adds length bytes to a CRC-32 eight bytes at a time
+uint32_t crc32SliceBy8(uint32_t crc, const unsigned char data[], unsigned long length) {
+    if (!tablesReady) {
+        buildTables();
+    }
+    unsigned long i = 0;
+    for (; i + 8 <= length; i += 8) {
+        const unsigned char *p = data + i;
+        uint32_t low = crc ^ ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+        crc = crc32Tables[7][low & 0xFF] ^ crc32Tables[6][(low >> 8) & 0xFF] ^
+              crc32Tables[5][(low >> 16) & 0xFF] ^ crc32Tables[4][low >> 24] ^
+              crc32Tables[3][p[4]] ^ crc32Tables[2][p[5]] ^ crc32Tables[1][p[6]] ^ crc32Tables[0][p[7]];
+    }
+    for (; i < length; i++) {
+        crc = (crc >> 8) ^ crc32Tables[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+#endif
+
+//Adds length bytes to a CRC-16 with the fastest variant built for this platform
+unsigned short crc16(unsigned short crc, const unsigned char data[], unsigned long length) {
+#ifdef __AVR__
+    return crc16Nibble(crc, data, length);
+#else
+    return crc16SliceBy8(crc, data, length);
+#endif
+}
+
+//Adds length bytes to a CRC-32 with the fastest variant built for this platform
+uint32_t crc32(uint32_t crc, const unsigned char data[], unsigned long length) {
+#ifdef __AVR__
+    return crc32Nibble(crc, data, length);
+#else
+    return crc32SliceBy8(crc, data, length);
+#endif
+}
+
+//Checks every variant against the standard check values and against each other
+//Returns 1 if they all agree. On the host this also builds the slice-by-8 tables, call it before starting threads
+int crcSelfTest(void) {
+    static const unsigned char check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    if (crc16Nibble(CRC16_INIT, check, sizeof(check)) != CRC16_CHECK ||
+        crc32Final(crc32Nibble(CRC32_INIT, check, sizeof(check))) != CRC32_CHECK) {
+        return 0;
+    }
+#ifndef __AVR__
+    if (crc16SliceBy8(CRC16_INIT, check, sizeof(check)) != CRC16_CHECK ||
+        crc32Final(crc32SliceBy8(CRC32_INIT, check, sizeof(check))) != CRC32_CHECK) {
+        return 0;
+    }
+    //Every length up to a few slices, so the tail handling after the 8 byte loop is covered
+    unsigned char data[67];
+    for (unsigned int i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char) (i * 37 + 11);
+    }
+    for (unsigned long length = 0; length <= sizeof(data); length++) {
+        if (crc16SliceBy8(CRC16_INIT, data, length) != crc16Nibble(CRC16_INIT, data, length) ||
+            crc32SliceBy8(CRC32_INIT, data, length) != crc32Nibble(CRC32_INIT, data, length)) {
+            return 0;
+        }
+    }
+#endif
+    return 1;
+}
@@ -0,0 +1,59 @@
+//Table driven checksums for framed serial I/O
+//Plain C with no Arduino dependencies so it builds for both the satellite and the ground tools
+//The nibble table variants need 32 or 64 bytes of table and are what the satellite uses
+//The slice-by-8 variants need 4KB or 8KB of tables and are what the host tools use, they are not built for AVR
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//CRC-16/CCITT-FALSE: polynomial 0x1021, not reflected, start from CRC16_INIT, no final xor
+#define CRC16_INIT 0xFFFF
+//CRC-16 of the ASCII bytes "123456789"
+#define CRC16_CHECK 0x29B1
+
+//CRC-32 (IEEE 802.3): polynomial 0x04C11DB7 reflected, start from CRC32_INIT, pass the result through crc32Final
+#define CRC32_INIT 0xFFFFFFFFUL
+//Final CRC-32 of the ASCII bytes "123456789"
+#define CRC32_CHECK 0xCBF43926UL
+
+//Adds one byte to a CRC-16
+unsigned short crc16Update(unsigned short crc, unsigned char byte);
+
+//Adds length bytes to a CRC-16 with the nibble table
+unsigned short crc16Nibble(unsigned short crc, const unsigned char data[], unsigned long length);
+
+//Adds length bytes to a CRC-32 with the nibble table
+uint32_t crc32Nibble(uint32_t crc, const unsigned char data[], unsigned long length);
+
+#ifndef __AVR__
+//Adds length bytes to a CRC-16 eight bytes at a time
+unsigned short crc16SliceBy8(unsigned short crc, const unsigned char data[], unsigned long length);
+
+//Adds length bytes to a CRC-32 eight bytes at a time
+uint32_t crc32SliceBy8(uint32_t crc, const unsigned char data[], unsigned long length);
+#endif
+
+//Adds length bytes to a CRC-16 with the fastest variant built for this platform
+unsigned short crc16(unsigned short crc, const unsigned char data[], unsigned long length);
+
+//Adds length bytes to a CRC-32 with the fastest variant built for this platform
+uint32_t crc32(uint32_t crc, const unsigned char data[], unsigned long length);
+
+//Returns the CRC-32 to transmit or compare from a running CRC-32
+uint32_t crc32Final(uint32_t crc);
+
+//Checks every variant against the standard check values and against each other
+//Returns 1 if they all agree. On the host this also builds the slice-by-8 tables, call it before starting threads
+int crcSelfTest(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CRC_H
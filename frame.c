@@ -0,0 +1,123 @@
+#include <string.h>
+#include "frame.h"
+#include "crc.h"
+
+//Returns the CRC-16/CCITT-FALSE of a frame's length, type and payload
+unsigned short frameCrc(unsigned char type, const unsigned char payload[], unsigned char length) {
+    unsigned short crc = crc16Update(crc16Update(CRC16_INIT, length), type);
+    return crc16(crc, payload, length);
+}
+
+//Finds the next frame with a good CRC in buffer starting at *position, for captures already in memory
+//Returns 1, fills frame and moves *position past it if one is found
+//Returns 0 with *position at the first byte that may still start a frame once more bytes are appended
+int frameScan(const unsigned char buffer[], unsigned long length, unsigned long *position, FrameSpan *frame,
+              FrameScanStats *stats) {
+    unsigned long i = *position;
+    while (i < length) {
+        if (buffer[i] != FRAME_SYNC) {
+            //Skip ahead to the next possible start, most of a capture can be console text
+            const unsigned char *next = memchr(buffer + i, FRAME_SYNC, length - i);
+            unsigned long skip = next != NULL ? (unsigned long) (next - (buffer + i)) : length - i;
+            stats->droppedBytes += skip;
+            i += skip;
+            continue;
+        }
+        if (length - i < FRAME_OVERHEAD || length - i < (unsigned long) buffer[i + 1] + FRAME_OVERHEAD) {
+            break; //Frame not complete yet
+        }
+        unsigned char frameLength = buffer[i + 1];
+        const unsigned char *crcBytes = buffer + i + 3 + frameLength;
+        if (frameCrc(buffer[i + 2], buffer + i + 3, frameLength) != (unsigned short) (crcBytes[0] << 8 | crcBytes[1])) {
+            stats->crcErrors++;
+            stats->droppedBytes++;
+            i++;
+            continue;
+        }
+        frame->type = buffer[i + 2];
+        frame->length = frameLength;
+        frame->payload = buffer + i + 3;
+        stats->frames++;
+        *position = i + frameLength + FRAME_OVERHEAD;
+        return 1;
+    }
+    *position = i;
+    return 0;
+}
+
+//Adds a received byte to the ring, returns 0 and counts an overflow if the ring is full
+int frameRingPut(FrameRing *ring, unsigned char byte) {
+    unsigned char head = ring->head;
+    unsigned char next = (unsigned char) ((head + 1) & FRAME_RING_MASK);
+    if (next == ring->tail) {
+        ring->overflows++;
+        return 0;
+    }
+    ring->data[head] = byte;
+    ring->head = next; //Published last so the consumer never sees an unwritten byte
+    return 1;
+}
+
+//Returns the number of bytes waiting in the ring
+unsigned int frameRingUsed(const FrameRing *ring) {
+    return (unsigned int) ((ring->head - ring->tail) & FRAME_RING_MASK);
+}
+
+//Returns the byte offset positions after the ring's tail
+static unsigned char peek(const FrameRing *ring, unsigned int offset) {
+    return ring->data[(ring->tail + offset) & FRAME_RING_MASK];
+}
+
+//Finds the next complete frame with a good CRC, skipping noise and damaged frames
+//Returns 1 and fills frame if one is ready, 0 if more bytes are needed. Call frameRelease once done with it
+int frameNext(FrameRing *ring, FrameView *frame) {
+    unsigned int used;
+    while ((used = frameRingUsed(ring)) > 0) {
+        if (peek(ring, 0) != FRAME_SYNC || (used >= 2 && peek(ring, 1) > FRAME_MAX_PAYLOAD)) {
+            //Not the start of a frame, resynchronize on the next byte
+            ring->tail = (unsigned char) ((ring->tail + 1) & FRAME_RING_MASK);
+            ring->droppedBytes++;
+            continue;
+        }
+        if (used < FRAME_OVERHEAD) {
+            return 0;
+        }
+        unsigned char length = peek(ring, 1);
+        if (used < (unsigned int) length + FRAME_OVERHEAD) {
+            return 0;
+        }
+        unsigned char type = peek(ring, 2);
+        unsigned short crc = crc16Update(crc16Update(CRC16_INIT, length), type);
+        //The payload is at most two runs of the ring, one before and one after it wraps
+        unsigned int start = (ring->tail + 3) & FRAME_RING_MASK;
+        unsigned int beforeWrap = FRAME_RING_SIZE - start < length ? FRAME_RING_SIZE - start : length;
+        crc = crc16(crc, &ring->data[start], beforeWrap);
+        crc = crc16(crc, &ring->data[0], length - beforeWrap);
+        unsigned short received = (unsigned short) (peek(ring, 3 + length) << 8 | peek(ring, 4 + length));
+        if (crc != received) {
+            //The sync byte may have been payload, resynchronize on the byte after it
+            ring->crcErrors++;
+            ring->tail = (unsigned char) ((ring->tail + 1) & FRAME_RING_MASK);
+            ring->droppedBytes++;
+            continue;
+        }
+        frame->ring = ring;
+        frame->type = type;
+        frame->length = length;
+        frame->start = (unsigned char) ((ring->tail + 3) & FRAME_RING_MASK);
+        frame->end = (unsigned char) ((ring->tail + length + FRAME_OVERHEAD) & FRAME_RING_MASK);
+        ring->frames++;
+        return 1;
+    }
+    return 0;
+}
+
+//Returns byte index of a frame's payload, straight from the ring
+unsigned char frameByte(const FrameView *frame, unsigned int index) {
+    return frame->ring->data[(frame->start + index) & FRAME_RING_MASK];
+}
+
+//Frees the ring space of a frame returned by frameNext
+void frameRelease(FrameRing *ring, const FrameView *frame) {
+    ring->tail = frame->end;
+}
@@ -0,0 +1,100 @@
+//Framing for every message on the serial link, both directions
+//A frame is FRAME_SYNC, payload length, type, payload, then a CRC-16 of length, type and payload, high byte first
+//Plain C with no Arduino dependencies so it builds for both the satellite and the ground tools
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_SYNC 0xA5
+//Sync, length, type and the two CRC bytes
+#define FRAME_OVERHEAD 5
+
+//Frame types
+#define FRAME_TELEMETRY_BATCH 0x01 //Downlink, payload is an encodeTelemetryBatch batch
+#define FRAME_TRACE 0x02 //Downlink, payload is packTraceEvents events
+#define FRAME_METRICS 0x03 //Downlink, payload is a packMetrics dump sent in answer to FRAME_METRICS_REQUEST
+#define FRAME_THRUST_COMMAND 0x10 //Uplink, payload is a 16 bit thruster signal, high byte first
+#define FRAME_SET_MODE 0x11 //Uplink, payload is one byte, nonzero selects the console status mode
+#define FRAME_METRICS_REQUEST 0x12 //Uplink, no payload, asks for a FRAME_METRICS dump
+
+//Bytes the receive ring holds, must be a power of two no larger than 256
+#ifndef FRAME_RING_SIZE
+#define FRAME_RING_SIZE 128
+#endif
+#define FRAME_RING_MASK (FRAME_RING_SIZE - 1)
+//Largest payload that still fits the ring with its header and CRC
+#define FRAME_MAX_PAYLOAD (FRAME_RING_SIZE - FRAME_OVERHEAD - 1)
+
+//Single producer single consumer ring of received bytes
+//The producer only writes head and the consumer only writes tail, so an interrupt can feed it without locking
+struct FrameRingStruct {
+    unsigned char data[FRAME_RING_SIZE];
+    volatile unsigned char head;
+    volatile unsigned char tail;
+    unsigned int overflows; //Bytes lost because the ring was full
+    unsigned int droppedBytes; //Bytes skipped while looking for a frame
+    unsigned int crcErrors;
+    unsigned long frames;
+};
+typedef struct FrameRingStruct FrameRing;
+
+//A complete frame still sitting in the ring, payload bytes are read in place with frameByte
+struct FrameViewStruct {
+    const FrameRing *ring;
+    unsigned char type;
+    unsigned char length;
+    unsigned char start; //Ring index of the first payload byte
+    unsigned char end; //Ring index just past the CRC
+};
+typedef struct FrameViewStruct FrameView;
+
+//A complete frame found in a contiguous buffer, the payload points into that buffer
+struct FrameSpanStruct {
+    unsigned char type;
+    unsigned char length;
+    const unsigned char *payload;
+};
+typedef struct FrameSpanStruct FrameSpan;
+
+//Counts kept while scanning a contiguous buffer for frames
+struct FrameScanStatsStruct {
+    unsigned long long droppedBytes; //Bytes that were not part of a good frame, console text included
+    unsigned long long crcErrors;
+    unsigned long long frames;
+};
+typedef struct FrameScanStatsStruct FrameScanStats;
+
+//Returns the CRC-16/CCITT-FALSE of a frame's length, type and payload
+unsigned short frameCrc(unsigned char type, const unsigned char payload[], unsigned char length);
+
+//Finds the next frame with a good CRC in buffer starting at *position, for captures already in memory
+//Returns 1, fills frame and moves *position past it if one is found
+//Returns 0 with *position at the first byte that may still start a frame once more bytes are appended
+int frameScan(const unsigned char buffer[], unsigned long length, unsigned long *position, FrameSpan *frame,
+              FrameScanStats *stats);
+
+//Adds a received byte to the ring, returns 0 and counts an overflow if the ring is full
+int frameRingPut(FrameRing *ring, unsigned char byte);
+
+//Returns the number of bytes waiting in the ring
+unsigned int frameRingUsed(const FrameRing *ring);
+
+//Finds the next complete frame with a good CRC, skipping noise and damaged frames
+//Returns 1 and fills frame if one is ready, 0 if more bytes are needed. Call frameRelease once done with it
+int frameNext(FrameRing *ring, FrameView *frame);
+
+//Returns byte index of a frame's payload, straight from the ring
+unsigned char frameByte(const FrameView *frame, unsigned int index);
+
+//Frees the ring space of a frame returned by frameNext
+void frameRelease(FrameRing *ring, const FrameView *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FRAME_H
@@ -0,0 +1,54 @@
+#include "hosttools.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frame.h"
+
+//Returns a monotonic time in seconds
+double seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+//Writes a frame into out, which must hold length + FRAME_OVERHEAD bytes, and returns its size
+unsigned int packFrame(unsigned char type, const unsigned char payload[], unsigned char length, unsigned char out[]) {
+    unsigned short crc = frameCrc(type, payload, length);
+    out[0] = FRAME_SYNC;
+    out[1] = length;
+    out[2] = type;
+    if (length > 0) {
+        memcpy(&out[3], payload, length);
+    }
+    out[3 + length] = (unsigned char) (crc >> 8);
+    out[4 + length] = (unsigned char) (crc & 0xFF);
+    return length + FRAME_OVERHEAD;
+}
+
+//Writes one frame to out
+void writeFrame(FILE *out, unsigned char type, const unsigned char payload[], unsigned char length) {
+    unsigned char frame[0xFF + FRAME_OVERHEAD];
+    fwrite(frame, 1, packFrame(type, payload, length, frame), out);
+}
+
+//Orders doubles for qsort
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+//Prints how many of total runs reached a value and the mean and percentiles of the count values, sorted in place
+void printDistribution(const char *name, double values[], long count, long total) {
+    if (count == 0) {
+        printf("  %-20s never reached in %ld runs\n", name, total);
+        return;
+    }
+    qsort(values, (size_t) count, sizeof(double), compareDoubles);
+    double sum = 0;
+    for (long i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    printf("  %-20s %7ld/%-7ld mean %10.1f  min %10.1f  p5 %10.1f  p50 %10.1f  p95 %10.1f  max %10.1f\n",
+           name, count, total, sum / count, values[0], values[count * 5 / 100], values[count / 2],
+           values[count * 95 / 100], values[count - 1]);
+}
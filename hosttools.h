@@ -0,0 +1,29 @@
+//Helpers shared by the host tools: timing, writing frames the way the satellite sends them and summarizing results
+//Host only, the satellite has its own serial code
+
+#ifndef HOSTTOOLS_H
+#define HOSTTOOLS_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Returns a monotonic time in seconds
+double seconds();
+
+//Writes a frame into out, which must hold length + FRAME_OVERHEAD bytes, and returns its size
+unsigned int packFrame(unsigned char type, const unsigned char payload[], unsigned char length, unsigned char out[]);
+
+//Writes one frame to out
+void writeFrame(FILE *out, unsigned char type, const unsigned char payload[], unsigned char length);
+
+//Prints how many of total runs reached a value and the mean and percentiles of the count values, sorted in place
+void printDistribution(const char *name, double values[], long count, long total);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //HOSTTOOLS_H
@@ -0,0 +1,30 @@
+#include "idle.h"
+
+//Starts a new reporting window at now
+void resetIdleStats(IdleStats *stats, unsigned long now) {
+    stats->sleeps = 0;
+    stats->idleMicros = 0;
+    stats->windowStart = now;
+}
+
+//Adds one idle stretch of the given length to the window
+void recordIdle(IdleStats *stats, unsigned long idleMicros) {
+    stats->sleeps++;
+    stats->idleMicros += idleMicros;
+}
+
+//Returns the part of the window up to now spent running, in tenths of a percent
+unsigned int dutyCyclePermille(const IdleStats *stats, unsigned long now) {
+    unsigned long window = now - stats->windowStart;
+    if (window == 0) {
+        return 0;
+    }
+    unsigned long idle = stats->idleMicros < window ? stats->idleMicros : window;
+    //Scaled down first when needed so the product fits an unsigned long on the 32 bit satellite
+    unsigned long busy = window - idle;
+    while (window > 4000000UL) {
+        window >>= 1;
+        busy >>= 1;
+    }
+    return (unsigned int) (busy * 1000UL / window);
+}
@@ -0,0 +1,33 @@
+//Accounting for the time the scheduler spends asleep between task releases
+//Plain C with no Arduino dependencies so the host schedule simulator measures duty cycle the same way
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Idle time over one reporting window, times are in microseconds and may wrap
+struct IdleStatsStruct {
+    unsigned long sleeps; //Times the scheduler went idle
+    unsigned long idleMicros;
+    unsigned long windowStart;
+};
+typedef struct IdleStatsStruct IdleStats;
+
+//Starts a new reporting window at now
+void resetIdleStats(IdleStats *stats, unsigned long now);
+
+//Adds one idle stretch of the given length to the window
+void recordIdle(IdleStats *stats, unsigned long idleMicros);
+
+//Returns the part of the window up to now spent running, in tenths of a percent
+//A window shorter than a reporting period may wrap the clock once, windows longer than the clock range are not supported
+unsigned int dutyCyclePermille(const IdleStats *stats, unsigned long now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //IDLE_H
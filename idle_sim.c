@@ -0,0 +1,226 @@
+//Replays the satellite's release schedule on a simulated clock and reports how long the scheduler would sleep
+//Task costs are the dispatch times measured on the satellite, so a scheduling change can be compared by duty cycle
+//Usage: idle_sim [-t period_ms:cost_us]... [-i poll_ms] [-s summary_ms:cost_us] [-c checkpoint_ms:passes:pass_us]
+//                [-l seconds] [-o trace]
+//       with no -t the four runDelay tasks and the two every pass tasks of the sketch are used at 1ms each
+//       -s is the statistics summary, by default every 60s taking about 200ms to print 200 characters at 9600 baud
+//       -c is the checkpoint save, by default every 60s in 15 passes of 2 EEPROM bytes at about 3.4ms each
+//       an interval of 0 leaves either out
+//       -o writes the simulated timeline as Chrome trace JSON
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include "idle.h"
+#include "trace.h"
+
+//Most tasks one simulation takes with -t
+#define MAX_TASKS 16
+
+//A task as the scheduler sees it, all times are in microseconds
+struct SimTaskStruct {
+    unsigned long long period; //0 runs the task on every pass
+    unsigned long long cost;
+    unsigned long long nextReleaseTime;
+    unsigned long dispatches;
+};
+typedef struct SimTaskStruct SimTask;
+
+//Work the scheduler loop does besides the tasks, all times are in microseconds
+struct HousekeepingStruct {
+    unsigned long long summaryInterval; //0 disables the statistics summary
+    unsigned long long summaryCost;
+    unsigned long long checkpointInterval; //0 disables checkpoints
+    unsigned int checkpointPasses; //A save is spread over this many passes, one after the other
+    unsigned long long checkpointPassCost;
+    unsigned long summaries;
+    unsigned long checkpoints;
+};
+typedef struct HousekeepingStruct Housekeeping;
+
+//Writes one event to trace if there is one
+void traceSim(ChromeTrace *trace, unsigned long long time, unsigned char type, unsigned char arg) {
+    if (trace != NULL) {
+        TraceEvent event = {(uint32_t) time, type, arg};
+        writeChromeTraceEvent(trace, &event);
+    }
+}
+
+//Runs the schedule for limit microseconds the way scheduleTask does, sleeping to the next wake after every pass
+//The summary and the checkpoint passes appear in the trace as the tasks after the last one
+//Simulated microseconds are kept in an unsigned long, so this expects the 64 bit longs of the host
+void simulate(SimTask tasks[], int taskCount, Housekeeping *housekeeping, unsigned long long pollInterval,
+              unsigned long long limit, IdleStats *idle, ChromeTrace *trace) {
+    unsigned long long now = 0;
+    unsigned long long nextSummaryTime = housekeeping->summaryInterval;
+    unsigned long long nextCheckpointTime = housekeeping->checkpointInterval;
+    unsigned int checkpointPassesLeft = 0;
+    resetIdleStats(idle, 0);
+    while (now < limit) {
+        for (int i = 0; i < taskCount; i++) {
+            SimTask *task = &tasks[i];
+            if (task->period > 0 && now < task->nextReleaseTime) {
+                continue;
+            }
+            traceSim(trace, now, TRACE_TASK_BEGIN, (unsigned char) i);
+            now += task->cost;
+            traceSim(trace, now, TRACE_TASK_END, (unsigned char) i);
+            task->dispatches++;
+            if (task->period > 0) { //Same cadence rule as dispatchTask, missed releases are skipped
+                task->nextReleaseTime += task->period;
+                if (now >= task->nextReleaseTime) {
+                    task->nextReleaseTime += ((now - task->nextReleaseTime) / task->period + 1) * task->period;
+                }
+            }
+        }
+
+        if (housekeeping->summaryInterval > 0 && now >= nextSummaryTime) {
+            traceSim(trace, now, TRACE_TASK_BEGIN, (unsigned char) taskCount);
+            now += housekeeping->summaryCost;
+            traceSim(trace, now, TRACE_TASK_END, (unsigned char) taskCount);
+            housekeeping->summaries++;
+            nextSummaryTime = now + housekeeping->summaryInterval;
+        }
+        //A save runs one pass per scheduler pass until it is done, then the next one is timed from there
+        if (housekeeping->checkpointInterval > 0 && now >= nextCheckpointTime) {
+            if (checkpointPassesLeft == 0) {
+                checkpointPassesLeft = housekeeping->checkpointPasses;
+            }
+            traceSim(trace, now, TRACE_TASK_BEGIN, (unsigned char) (taskCount + 1));
+            now += housekeeping->checkpointPassCost;
+            traceSim(trace, now, TRACE_TASK_END, (unsigned char) (taskCount + 1));
+            if (--checkpointPassesLeft == 0) {
+                housekeeping->checkpoints++;
+                nextCheckpointTime = now + housekeeping->checkpointInterval;
+            }
+        }
+
+        //Same wake rule as nextWakeTime: the summary, or the poll interval with no summary, then the checkpoint,
+        //a save in progress, the task releases, and tasks that run on every pass polled every pollInterval
+        unsigned long long wakeTime = housekeeping->summaryInterval > 0 ? nextSummaryTime : now + pollInterval;
+        if (housekeeping->checkpointInterval > 0 && nextCheckpointTime < wakeTime) {
+            wakeTime = nextCheckpointTime;
+        }
+        for (int i = 0; i < taskCount; i++) {
+            unsigned long long releaseTime = tasks[i].period > 0 ? tasks[i].nextReleaseTime : now + pollInterval;
+            if (releaseTime < wakeTime) {
+                wakeTime = releaseTime;
+            }
+        }
+        if (wakeTime > limit) {
+            wakeTime = limit;
+        }
+        if (wakeTime > now) {
+            traceSim(trace, now, TRACE_IDLE_BEGIN, 0);
+            recordIdle(idle, (unsigned long) (wakeTime - now));
+            now = wakeTime;
+            traceSim(trace, now, TRACE_IDLE_END, 0);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    SimTask tasks[MAX_TASKS];
+    int taskCount = 0;
+    unsigned long long pollInterval = 20000;
+    Housekeeping housekeeping = {60000000ULL, 200000ULL, 60000000ULL, 15, 6800ULL, 0, 0};
+    double limit = 3600;
+    const char *tracePath = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "t:i:s:c:l:o:")) != -1) {
+        switch (option) {
+            case 't': {
+                unsigned long period, cost;
+                if (taskCount == MAX_TASKS || sscanf(optarg, "%lu:%lu", &period, &cost) != 2) {
+                    fprintf(stderr, "-t takes period_ms:cost_us, at most %d times\n", MAX_TASKS);
+                    return 1;
+                }
+                tasks[taskCount].period = period * 1000ULL;
+                tasks[taskCount].cost = cost;
+                taskCount++;
+                break;
+            }
+            case 'i':
+                pollInterval = strtoull(optarg, NULL, 10) * 1000ULL;
+                break;
+            case 's': {
+                unsigned long interval, cost;
+                if (sscanf(optarg, "%lu:%lu", &interval, &cost) != 2) {
+                    fprintf(stderr, "-s takes summary_ms:cost_us\n");
+                    return 1;
+                }
+                housekeeping.summaryInterval = interval * 1000ULL;
+                housekeeping.summaryCost = cost;
+                break;
+            }
+            case 'c': {
+                unsigned long interval, cost;
+                unsigned int passes;
+                if (sscanf(optarg, "%lu:%u:%lu", &interval, &passes, &cost) != 3 || passes == 0) {
+                    fprintf(stderr, "-c takes checkpoint_ms:passes:pass_us with at least one pass\n");
+                    return 1;
+                }
+                housekeeping.checkpointInterval = interval * 1000ULL;
+                housekeeping.checkpointPasses = passes;
+                housekeeping.checkpointPassCost = cost;
+                break;
+            }
+            case 'l':
+                limit = atof(optarg);
+                break;
+            case 'o':
+                tracePath = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t period_ms:cost_us]... [-i poll_ms] [-s summary_ms:cost_us]"
+                                " [-c checkpoint_ms:passes:pass_us] [-l seconds] [-o trace]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (taskCount == 0) {
+        unsigned long long periods[] = {5000000, 5000000, 5000000, 5000000, 0, 0};
+        for (; taskCount < 6; taskCount++) {
+            tasks[taskCount].period = periods[taskCount];
+            tasks[taskCount].cost = 1000;
+        }
+    }
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].nextReleaseTime = 0;
+        tasks[i].dispatches = 0;
+    }
+
+    if (limit <= 0) {
+        fprintf(stderr, "need a positive time limit\n");
+        return 1;
+    }
+    ChromeTrace trace;
+    FILE *traceOut = NULL;
+    if (tracePath != NULL) {
+        traceOut = fopen(tracePath, "w");
+        if (traceOut == NULL) {
+            perror(tracePath);
+            return 1;
+        }
+        beginChromeTrace(&trace, traceOut, NULL, 0);
+    }
+    IdleStats idle;
+    unsigned long long limitMicros = (unsigned long long) (limit * 1e6);
+    simulate(tasks, taskCount, &housekeeping, pollInterval, limitMicros, &idle, traceOut != NULL ? &trace : NULL);
+    if (traceOut != NULL) {
+        endChromeTrace(&trace);
+        fclose(traceOut);
+    }
+
+    for (int i = 0; i < taskCount; i++) {
+        printf("task %d period=%llums cost=%lluus n=%lu\n", i, tasks[i].period / 1000, tasks[i].cost,
+               tasks[i].dispatches);
+    }
+    printf("summary period=%llums cost=%lluus n=%lu\n", housekeeping.summaryInterval / 1000, housekeeping.summaryCost,
+           housekeeping.summaries);
+    printf("checkpoint period=%llums passes=%u cost=%lluus n=%lu\n", housekeeping.checkpointInterval / 1000,
+           housekeeping.checkpointPasses, housekeeping.checkpointPassCost, housekeeping.checkpoints);
+    unsigned int duty = dutyCyclePermille(&idle, (unsigned long) limitMicros);
+    printf("idle n=%lu slept=%.3fs duty=%u.%u%%\n", idle.sleeps, idle.idleMicros / 1e6, duty / 10, duty % 10);
+    return 0;
+}
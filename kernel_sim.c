@@ -0,0 +1,286 @@
+//Runs a task set through the preemptive kernel's priority logic on the host and compares it with the task loop alone
+//The kernel is modeled as main.c builds it with USE_PREEMPTIVE_KERNEL: a 1ms tick that may interrupt anything,
+//itself included, runs every released task of each level above the priority of the code it interrupted, highest
+//first, to completion on top of it. That needs no stack per task, so the model is plain recursion on a simulated
+//microsecond clock rather than threads or ucontext. lockDisplay raises the running priority to the top level
+//Checks that a task only ever preempts lower priority code, that no task at or below the top level starts while the
+//display is locked, and reports how late each level starts both ways
+//Usage: kernel_sim [-l levels] [-n tasks] [-u utilization_permille] [-d duration_ms] [-s seed]
+//  -l levels  priority levels including the background, the satellite has 2 (default 3)
+//  -u         share of the processor the task set needs, in thousandths (default 600)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "registry.h"
+#include "timebase.h"
+
+//Most priority levels and tasks one run takes
+#define MAX_LEVELS 8
+#define MAX_TASKS TASK_REGISTRY_CAPACITY
+//Task periods are drawn from this range of milliseconds
+#define MIN_PERIOD 10
+#define MAX_PERIOD 1000
+#define TICK_US 1000
+//Violations printed before they are only counted
+#define MAX_REPORTED 10
+#define BACKGROUND 0
+
+//A synthetic task, scheduled through entry like a TCB
+struct SimTaskStruct {
+    ScheduleEntry entry;
+    unsigned char priority;
+    unsigned long period; //Milliseconds
+    unsigned long cost; //Microseconds of work per run
+    unsigned long lockedCost; //Microseconds of that work spent holding the display lock
+};
+typedef struct SimTaskStruct SimTask;
+
+//What one priority level saw
+struct LevelStatsStruct {
+    unsigned long dispatches;
+    unsigned long deadlineMisses;
+    unsigned long long latencySum; //Microseconds from release to start
+    unsigned long maxLatency;
+};
+typedef struct LevelStatsStruct LevelStats;
+
+//The simulated processor
+struct SimStruct {
+    Bool preemptive;
+    unsigned char levels;
+    unsigned long long now; //Microseconds
+    unsigned long long nextTick;
+    unsigned char runningPriority;
+    Bool displayLocked;
+    unsigned char stack[MAX_TASKS + 1]; //Priorities of the tasks running, the innermost last
+    int depth;
+    unsigned long violations;
+    TaskRegistry loopTasks;
+    TaskRegistry kernelTasks[MAX_LEVELS - 1];
+    LevelStats stats[MAX_LEVELS];
+};
+typedef struct SimStruct Sim;
+
+void kernelTick(Sim *sim);
+
+//Returns the next number of a small generator
+unsigned long nextRandom(unsigned long *state) {
+    *state = *state * 1103515245UL + 12345UL;
+    return (*state >> 16) & 0x7FFF;
+}
+
+//Returns the simulated millis()
+unsigned long systemTime(const Sim *sim) {
+    return (unsigned long) (uint32_t) (sim->now / 1000);
+}
+
+//Advances the clock through cost microseconds of work, taking the timer interrupt at every tick on the way
+//With the kernel off the tick only keeps millis(), as Timer0 does
+void work(Sim *sim, unsigned long long cost) {
+    while (sim->now + cost >= sim->nextTick) {
+        cost -= sim->nextTick - sim->now;
+        sim->now = sim->nextTick;
+        sim->nextTick += TICK_US;
+        if (sim->preemptive) {
+            kernelTick(sim);
+        }
+    }
+    sim->now += cost;
+}
+
+//Raises the running priority to the top level so no task drawing on the tft preempts, returns the priority to restore
+unsigned char lockDisplay(Sim *sim) {
+    unsigned char previousPriority = sim->runningPriority;
+    if (sim->runningPriority < sim->levels - 1) {
+        sim->runningPriority = (unsigned char) (sim->levels - 1);
+    }
+    sim->displayLocked = TRUE;
+    return previousPriority;
+}
+
+//Lets tasks preempted by lockDisplay run again
+void unlockDisplay(Sim *sim, unsigned char previousPriority) {
+    sim->displayLocked = FALSE;
+    sim->runningPriority = previousPriority;
+}
+
+//Runs a task the way dispatchTask does and checks it was allowed to start
+void dispatchTask(Sim *sim, SimTask *task) {
+    if (sim->depth > 0 && task->priority <= sim->stack[sim->depth - 1] && sim->violations++ < MAX_REPORTED) {
+        fprintf(stderr, "at %llu us a level %u task preempted level %u\n", sim->now, task->priority,
+                sim->stack[sim->depth - 1]);
+    }
+    if (sim->displayLocked && task->priority > BACKGROUND && sim->violations++ < MAX_REPORTED) {
+        fprintf(stderr, "at %llu us a level %u task started with the display locked\n", sim->now, task->priority);
+    }
+    LevelStats *stats = &sim->stats[task->priority];
+    unsigned long long release = (unsigned long long) task->entry.releaseTime * 1000;
+    unsigned long latency = (unsigned long) (sim->now - release);
+    stats->dispatches++;
+    stats->latencySum += latency;
+    if (latency > stats->maxLatency) {
+        stats->maxLatency = latency;
+    }
+
+    sim->stack[sim->depth++] = task->priority;
+    work(sim, task->cost - task->lockedCost);
+    if (task->lockedCost > 0) {
+        unsigned char previousPriority = lockDisplay(sim);
+        work(sim, task->lockedCost);
+        unlockDisplay(sim, previousPriority);
+    }
+    sim->depth--;
+
+    //Releases stay on the original cadence, and a run that overran into the next skips the missed ones
+    unsigned long finishTime = systemTime(sim);
+    task->entry.releaseTime += task->period;
+    if (timeReached(finishTime, task->entry.releaseTime)) {
+        stats->deadlineMisses++;
+        task->entry.releaseTime += ((finishTime - task->entry.releaseTime) / task->period + 1) * task->period;
+    }
+}
+
+//Runs every task of registry that is released now and queues each again at its next release
+void runReleasedTasks(Sim *sim, TaskRegistry *registry) {
+    ScheduleEntry *entry = takeReleasedTasks(registry, systemTime(sim));
+    while (entry != 0x0) {
+        ScheduleEntry *next = entry->next;
+        if (entry->state == SCHEDULE_TAKEN) {
+            dispatchTask(sim, (SimTask *) entry->owner);
+            requeueTask(registry, entry);
+        }
+        entry = next;
+    }
+}
+
+//Runs every task whose priority is above the priority of the code the tick interrupted, highest first
+void kernelTick(Sim *sim) {
+    for (unsigned char level = (unsigned char) (sim->levels - 1); level > BACKGROUND; level--) {
+        unsigned char preempted = sim->runningPriority;
+        if (level <= preempted) { //Already running at this level or above, a later tick will get it
+            return;
+        }
+        sim->runningPriority = level;
+        runReleasedTasks(sim, &sim->kernelTasks[level - 1]);
+        sim->runningPriority = preempted;
+    }
+}
+
+//Runs the task set for duration milliseconds, through the kernel tick if sim->preemptive and the task loop alone if not
+void runTasks(Sim *sim, SimTask tasks[], int count, unsigned long duration) {
+    initTaskRegistry(&sim->loopTasks);
+    for (int level = 0; level < MAX_LEVELS - 1; level++) {
+        initTaskRegistry(&sim->kernelTasks[level]);
+    }
+    for (int i = 0; i < count; i++) {
+        TaskRegistry *registry = &sim->loopTasks;
+        if (sim->preemptive && tasks[i].priority > BACKGROUND) {
+            registry = &sim->kernelTasks[tasks[i].priority - 1];
+        }
+        tasks[i].entry.releaseTime = (unsigned long) (i % MIN_PERIOD);
+        tasks[i].entry.polled = FALSE;
+        registerTask(registry, &tasks[i].entry, &tasks[i]);
+    }
+    sim->now = 0;
+    sim->nextTick = TICK_US;
+    sim->runningPriority = BACKGROUND;
+    sim->displayLocked = FALSE;
+    sim->depth = 0;
+    sim->violations = 0;
+    memset(sim->stats, 0, sizeof(sim->stats));
+
+    while (systemTime(sim) < duration) {
+        runReleasedTasks(sim, &sim->loopTasks);
+        //Sleeps until the next loop release, the tick still interrupts the sleep
+        unsigned long wakeTime = duration;
+        unsigned long releaseTime;
+        if (earliestRelease(&sim->loopTasks, &releaseTime) && timeBefore(releaseTime, wakeTime)) {
+            wakeTime = releaseTime;
+        }
+        if (timeBefore(systemTime(sim), wakeTime)) {
+            work(sim, (unsigned long long) wakeTime * 1000 - sim->now);
+        }
+    }
+}
+
+//Prints what each level saw one way
+void report(const char *name, const Sim *sim) {
+    for (int level = sim->levels - 1; level >= 0; level--) {
+        const LevelStats *stats = &sim->stats[level];
+        printf("%-11s %5d %10lu %12.1f %12.1f %8lu\n", name, level, stats->dispatches,
+               stats->dispatches > 0 ? stats->latencySum / 1000.0 / stats->dispatches : 0.0,
+               stats->maxLatency / 1000.0, stats->deadlineMisses);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int levels = 3;
+    int count = 12;
+    unsigned long utilization = 600;
+    unsigned long duration = 600000;
+    unsigned long seed = 1000;
+    int option;
+    while ((option = getopt(argc, argv, "l:n:u:d:s:")) != -1) {
+        switch (option) {
+            case 'l':
+                levels = atoi(optarg);
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'u':
+                utilization = strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                duration = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-l levels] [-n tasks] [-u utilization_permille] [-d duration_ms]"
+                                " [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (levels < 2 || levels > MAX_LEVELS || count < levels || count > MAX_TASKS) {
+        fprintf(stderr, "-l takes 2 to %d levels and -n from the levels to %d tasks\n", MAX_LEVELS, MAX_TASKS);
+        return 1;
+    }
+    if (utilization == 0 || utilization >= 1000 || duration == 0) {
+        fprintf(stderr, "-u takes 1 to 999 and -d a positive duration\n");
+        return 1;
+    }
+
+    //Every level gets tasks, each needing an equal share of the utilization
+    //A third of the background tasks draw, holding the display lock for half of their run
+    static SimTask tasks[MAX_TASKS];
+    unsigned long state = seed;
+    for (int i = 0; i < count; i++) {
+        SimTask *task = &tasks[i];
+        task->priority = (unsigned char) (i % levels);
+        task->period = MIN_PERIOD + nextRandom(&state) % (MAX_PERIOD - MIN_PERIOD + 1);
+        task->cost = task->period * utilization / (unsigned long) count;
+        if (task->cost == 0) {
+            task->cost = 1;
+        }
+        task->lockedCost = task->priority == BACKGROUND && nextRandom(&state) % 3 == 0 ? task->cost / 2 : 0;
+    }
+
+    static Sim sim;
+    sim.levels = (unsigned char) levels;
+    printf("%-11s %5s %10s %12s %12s %8s\n", "", "level", "dispatches", "mean ms", "worst ms", "misses");
+    int failed = 0;
+    for (int preemptive = 0; preemptive <= 1; preemptive++) {
+        sim.preemptive = preemptive ? TRUE : FALSE;
+        runTasks(&sim, tasks, count, duration);
+        report(preemptive ? "kernel" : "task loop", &sim);
+        if (sim.violations > 0) {
+            fprintf(stderr, "%s: %lu priority violations\n", preemptive ? "kernel" : "task loop", sim.violations);
+            failed = 1;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,212 @@
+//Counts the LCD bus cycles of the dashboard's repeated drawing through lcdbus against the library calls it replaced
+//lcdbus is built with its host counters in place of the port writes. The library is modeled from the bytes its
+//ILI9341 code puts on the bus: a label streamed pixel by pixel through pushColors, a readout drawn with GFX text at
+//size 2, which fills every font pixel as its own rectangle, and a bar drawn with fillRect
+//The time estimate only counts the port writes, at LOAD_CYCLES and STROBE_CYCLES of a 16MHz Uno
+//Usage: lcd_bench [-l label] [-r readout] [-w bar_width]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lcdbus.h"
+
+//Screen and dashboard geometry, as in main.c
+#define SCREEN_WIDTH 240
+#define SCREEN_HEIGHT 320
+#define GLYPH_WIDTH 6
+#define GLYPH_HEIGHT 8
+#define TEXT_SCALE 2
+#define BAR_HEIGHT 14
+#define MAX_CHARS 16
+#define ROW_BYTES ((MAX_CHARS * GLYPH_WIDTH + 7) / 8)
+#define NONE 0x0000
+#define WHITE 0xFFFF
+#define CYAN 0x07FF
+//Clock cycles to put a byte on the data lines across two ports, and to pulse WR
+#define LOAD_CYCLES 10
+#define STROBE_CYCLES 4
+
+//5x7 font columns, least significant bit at the top, the same as labelGlyphs in main.c
+static const unsigned char glyphs[][6] = {
+        {'0', 0x3E, 0x51, 0x49, 0x45, 0x3E},
+        {'1', 0x00, 0x42, 0x7F, 0x40, 0x00},
+        {'2', 0x72, 0x49, 0x49, 0x49, 0x46},
+        {'3', 0x21, 0x41, 0x49, 0x4D, 0x33},
+        {'4', 0x18, 0x14, 0x12, 0x7F, 0x10},
+        {'5', 0x27, 0x45, 0x45, 0x45, 0x39},
+        {'6', 0x3C, 0x4A, 0x49, 0x49, 0x31},
+        {'7', 0x41, 0x21, 0x11, 0x09, 0x07},
+        {'8', 0x36, 0x49, 0x49, 0x49, 0x36},
+        {'9', 0x46, 0x49, 0x49, 0x29, 0x1E},
+        {'A', 0x7C, 0x12, 0x11, 0x12, 0x7C},
+        {'B', 0x7F, 0x49, 0x49, 0x49, 0x36},
+        {'E', 0x7F, 0x49, 0x49, 0x49, 0x41},
+        {'F', 0x7F, 0x09, 0x09, 0x09, 0x01},
+        {'L', 0x7F, 0x40, 0x40, 0x40, 0x40},
+        {'R', 0x7F, 0x09, 0x19, 0x29, 0x46},
+        {'T', 0x01, 0x01, 0x7F, 0x01, 0x01},
+        {'U', 0x3F, 0x40, 0x40, 0x40, 0x3F},
+        {'Y', 0x07, 0x08, 0x70, 0x08, 0x07}
+};
+
+//Text rasterized at font size, 1 bit per pixel with the most significant bit on the left
+struct TextBitmapStruct {
+    unsigned int width;
+    unsigned char rows[GLYPH_HEIGHT][ROW_BYTES];
+};
+typedef struct TextBitmapStruct TextBitmap;
+
+//Rasterizes up to MAX_CHARS characters of text, characters without a glyph are left blank
+void rasterize(const char *text, TextBitmap *bitmap) {
+    memset(bitmap, 0, sizeof(TextBitmap));
+    for (int i = 0; i < MAX_CHARS && text[i] != '\0'; i++) {
+        for (unsigned int glyph = 0; glyph < sizeof(glyphs) / sizeof(glyphs[0]); glyph++) {
+            if (glyphs[glyph][0] != text[i]) {
+                continue;
+            }
+            for (int column = 0; column < GLYPH_WIDTH - 1; column++) {
+                int x = i * GLYPH_WIDTH + column;
+                for (int y = 0; y < GLYPH_HEIGHT; y++) {
+                    if (glyphs[glyph][column + 1] & (1 << y)) {
+                        bitmap->rows[y][x / 8] |= 0x80 >> (x % 8);
+                    }
+                }
+            }
+        }
+        bitmap->width += GLYPH_WIDTH;
+    }
+}
+
+//Returns whether the pixel at x, y of bitmap is set
+int pixelSet(const TextBitmap *bitmap, unsigned int x, unsigned int y) {
+    return (bitmap->rows[y][x / 8] & (0x80 >> (x % 8))) != 0;
+}
+
+//Adds bytes written to the bus one at a time, each loaded onto the data lines and strobed
+void modelBytes(LcdBusCounts *counts, unsigned long bytes) {
+    counts->dataLoads += bytes;
+    counts->strobes += bytes;
+}
+
+//Adds the library's setAddrWindow, two commands with four parameter bytes each
+void modelWindow(LcdBusCounts *counts) {
+    counts->commands += 2;
+    counts->windows++;
+    modelBytes(counts, 10);
+}
+
+//Adds the library's fillRect, a window and a flood that strobes alone after the first pixel when its bytes match
+void modelFillRect(LcdBusCounts *counts, unsigned long pixels, unsigned short color) {
+    modelWindow(counts);
+    counts->commands++;
+    modelBytes(counts, 3); //Memory write command and the first pixel
+    if ((color >> 8) == (color & 0xFF)) {
+        counts->strobes += (pixels - 1) * 2;
+    } else {
+        modelBytes(counts, (pixels - 1) * 2);
+    }
+}
+
+//Adds print's old path, every pixel of the label through pushColors and the window reset to the whole screen after
+void modelLabel(LcdBusCounts *counts, const TextBitmap *bitmap) {
+    modelWindow(counts);
+    counts->commands++;
+    modelBytes(counts, 1 + (unsigned long) bitmap->width * TEXT_SCALE * GLYPH_HEIGHT * TEXT_SCALE * 2);
+    modelWindow(counts);
+}
+
+//Adds GFX text with a background color, each of a character cell's font pixels filled as a scale by scale rectangle
+void modelReadout(LcdBusCounts *counts, const TextBitmap *bitmap) {
+    for (unsigned int x = 0; x < bitmap->width; x++) {
+        for (unsigned int y = 0; y < GLYPH_HEIGHT; y++) {
+            modelFillRect(counts, TEXT_SCALE * TEXT_SCALE, pixelSet(bitmap, x, y) ? WHITE : NONE);
+        }
+    }
+}
+
+//Streams text through lcdbus the way print and drawText do
+void streamText(const TextBitmap *bitmap, unsigned short color) {
+    lcdStartWindow(0, 0, bitmap->width * TEXT_SCALE - 1, GLYPH_HEIGHT * TEXT_SCALE - 1);
+    for (int row = 0; row < GLYPH_HEIGHT * TEXT_SCALE; row++) {
+        lcdPushBitmapRow(bitmap->rows[row / TEXT_SCALE], bitmap->width, TEXT_SCALE, color, NONE);
+    }
+    lcdEndWindow();
+}
+
+//Returns the estimated microseconds the port writes of counts take
+double portMicroseconds(const LcdBusCounts *counts) {
+    return (counts->dataLoads * LOAD_CYCLES + counts->strobes * STROBE_CYCLES) / 16.0;
+}
+
+//Prints one drawing's counts through the library and through lcdbus
+void report(const char *name, const LcdBusCounts *library, const LcdBusCounts *bus) {
+    double libraryTime = portMicroseconds(library);
+    double busTime = portMicroseconds(bus);
+    printf("%-8s %8lu %8lu %8lu %10.1f | %8lu %8lu %8lu %10.1f %7.1fx\n", name, library->windows, library->dataLoads,
+           library->strobes, libraryTime, bus->windows, bus->dataLoads, bus->strobes, busTime,
+           busTime > 0 ? libraryTime / busTime : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    const char *label = "BATTERY";
+    const char *readout = "042";
+    unsigned int barWidth = 40;
+    int option;
+    while ((option = getopt(argc, argv, "l:r:w:")) != -1) {
+        switch (option) {
+            case 'l':
+                label = optarg;
+                break;
+            case 'r':
+                readout = optarg;
+                break;
+            case 'w':
+                barWidth = (unsigned int) atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-l label] [-r readout] [-w bar_width]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (barWidth < 1 || barWidth > SCREEN_WIDTH) {
+        fprintf(stderr, "-w takes 1 to %d pixels\n", SCREEN_WIDTH);
+        return 1;
+    }
+    lcdBusInit(SCREEN_WIDTH, SCREEN_HEIGHT);
+    TextBitmap labelBitmap, readoutBitmap;
+    rasterize(label, &labelBitmap);
+    rasterize(readout, &readoutBitmap);
+
+    printf("%-8s %8s %8s %8s %10s | %8s %8s %8s %10s %8s\n", "", "windows", "loads", "strobes", "library us",
+           "windows", "loads", "strobes", "lcdbus us", "speedup");
+    LcdBusCounts library;
+
+    memset(&library, 0, sizeof(library));
+    memset(&lcdBusCounts, 0, sizeof(lcdBusCounts));
+    modelLabel(&library, &labelBitmap);
+    streamText(&labelBitmap, WHITE);
+    report("label", &library, &lcdBusCounts);
+
+    memset(&library, 0, sizeof(library));
+    memset(&lcdBusCounts, 0, sizeof(lcdBusCounts));
+    modelReadout(&library, &readoutBitmap);
+    streamText(&readoutBitmap, WHITE);
+    report("readout", &library, &lcdBusCounts);
+
+    memset(&library, 0, sizeof(library));
+    memset(&lcdBusCounts, 0, sizeof(lcdBusCounts));
+    modelFillRect(&library, (unsigned long) barWidth * BAR_HEIGHT, CYAN);
+    lcdFillRect(0, 0, barWidth, BAR_HEIGHT, CYAN);
+    report("bar", &library, &lcdBusCounts);
+
+    //A gauge update is the bar change and the readout, a label is drawn when an alarm changes
+    memset(&library, 0, sizeof(library));
+    memset(&lcdBusCounts, 0, sizeof(lcdBusCounts));
+    modelFillRect(&library, (unsigned long) barWidth * BAR_HEIGHT, CYAN);
+    modelReadout(&library, &readoutBitmap);
+    lcdFillRect(0, 0, barWidth, BAR_HEIGHT, CYAN);
+    streamText(&readoutBitmap, WHITE);
+    report("gauge", &library, &lcdBusCounts);
+    return 0;
+}
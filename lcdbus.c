@@ -0,0 +1,137 @@
+#include "lcdbus.h"
+
+#ifdef __AVR__
+#include <avr/io.h>
+
+#if !defined(__AVR_ATmega328P__)
+#error "lcdbus.c writes the Uno's ports, other boards wire the shield differently"
+#endif
+
+//Puts a byte on the data lines, D0-D1 on PB0-PB1 and D2-D7 on PD2-PD7, leaving the serial pins alone
+#define LOAD_BYTE(b) { PORTD = (PORTD & 0x03) | ((b) & 0xFC); PORTB = (PORTB & 0xFC) | ((b) & 0x03); }
+//The chip latches the data lines on the rising edge of WR
+#define STROBE() { PORTC &= ~LCD_WR_BIT; PORTC |= LCD_WR_BIT; }
+#define CD_COMMAND() (PORTC &= ~LCD_CD_BIT)
+#define CD_DATA() (PORTC |= LCD_CD_BIT)
+#define CS_ACTIVE() (PORTC &= ~LCD_CS_BIT)
+#define CS_IDLE() (PORTC |= LCD_CS_BIT)
+#define COUNT(field)
+#else
+LcdBusCounts lcdBusCounts;
+
+#define LOAD_BYTE(b) ((void) (b), lcdBusCounts.dataLoads++)
+#define STROBE() (lcdBusCounts.strobes++)
+#define CD_COMMAND()
+#define CD_DATA()
+#define CS_ACTIVE()
+#define CS_IDLE()
+#define COUNT(field) (lcdBusCounts.field++)
+#endif
+
+static unsigned int screenWidth;
+static unsigned int screenHeight;
+
+//Writes a command byte, the bus is left in data mode for its parameters
+static void writeCommand(uint8_t command) {
+    CD_COMMAND();
+    LOAD_BYTE(command);
+    STROBE();
+    CD_DATA();
+    COUNT(commands);
+}
+
+//Writes a 16 bit parameter, high byte first
+static void writeData16(uint16_t value) {
+    LOAD_BYTE(value >> 8);
+    STROBE();
+    LOAD_BYTE(value & 0xFF);
+    STROBE();
+}
+
+//Takes the data lines and the control lines as outputs for drawing on a width by height screen
+void lcdBusInit(unsigned int width, unsigned int height) {
+    screenWidth = width;
+    screenHeight = height;
+#ifdef __AVR__
+    PORTC |= LCD_RD_BIT | LCD_WR_BIT | LCD_CS_BIT;
+    DDRC |= LCD_RD_BIT | LCD_WR_BIT | LCD_CD_BIT | LCD_CS_BIT;
+    DDRD |= 0xFC;
+    DDRB |= 0x03;
+#endif
+}
+
+//Selects the chip and opens the window from x0, y0 to x1, y1 inclusive for a pixel stream, row by row
+void lcdStartWindow(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) {
+    CS_ACTIVE();
+    writeCommand(LCD_COLUMN_ADDRESS_SET);
+    writeData16(x0);
+    writeData16(x1);
+    writeCommand(LCD_PAGE_ADDRESS_SET);
+    writeData16(y0);
+    writeData16(y1);
+    writeCommand(LCD_MEMORY_WRITE);
+    COUNT(windows);
+}
+
+//Streams count pixels of one color into the open window
+void lcdPushColor(uint16_t color, unsigned long count) {
+    uint8_t high = color >> 8;
+    uint8_t low = color & 0xFF;
+    if (high == low) { //Black, white and other gray levels, the data lines hold the byte for the whole run
+        LOAD_BYTE(high);
+        while (count--) {
+            STROBE();
+            STROBE();
+        }
+        return;
+    }
+    while (count--) {
+        LOAD_BYTE(high);
+        STROBE();
+        LOAD_BYTE(low);
+        STROBE();
+    }
+}
+
+//Streams count pixels from pixels into the open window
+void lcdPushPixels(const uint16_t pixels[], unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        writeData16(pixels[i]);
+    }
+}
+
+//Deselects the chip, the window stays set until the next one is opened
+void lcdEndWindow() {
+    CS_IDLE();
+}
+
+//Fills a w by h rectangle at x, y with color, clipped to the screen
+void lcdFillRect(unsigned int x, unsigned int y, unsigned int w, unsigned int h, uint16_t color) {
+    if (w == 0 || h == 0 || x >= screenWidth || y >= screenHeight) {
+        return;
+    }
+    if (w > screenWidth - x) {
+        w = screenWidth - x;
+    }
+    if (h > screenHeight - y) {
+        h = screenHeight - y;
+    }
+    lcdStartWindow(x, y, x + w - 1, y + h - 1);
+    lcdPushColor(color, (unsigned long) w * h);
+    lcdEndWindow();
+}
+
+//Streams one row of a 1 bit per pixel bitmap into the open window as runs of one color each
+void lcdPushBitmapRow(const unsigned char bits[], unsigned int width, unsigned char scale, uint16_t color,
+                      uint16_t background) {
+    unsigned int x = 0;
+    while (x < width) {
+        unsigned char set = bits[x / 8] & (0x80 >> (x % 8));
+        unsigned int end = x + 1;
+        while (end < width && ((bits[end / 8] & (0x80 >> (end % 8))) != 0) == (set != 0)) {
+            end++;
+        }
+        lcdPushColor(set ? color : background, (unsigned long) (end - x) * scale);
+        x = end;
+    }
+}
@@ -0,0 +1,70 @@
+//Minimal ILI9341 driver for the 8 bit parallel bus of the Elegoo 2.4" shield on an Uno, writing the port registers
+//directly. Pixels are streamed through one address window in runs, and a run whose color has equal high and low
+//bytes only strobes WR, the data lines already hold the byte
+//The library still identifies and initializes the chip, this only does the drawing the dashboard repeats
+//Coordinates are the chip's own, so the library must be left at rotation 0
+//On the host the port writes are replaced by counters, so the bus cycles a drawing costs can be measured
+//Plain C with no Arduino dependencies
+
+#ifndef LCDBUS_H
+#define LCDBUS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//ILI9341 commands used for drawing
+#define LCD_COLUMN_ADDRESS_SET 0x2A
+#define LCD_PAGE_ADDRESS_SET 0x2B
+#define LCD_MEMORY_WRITE 0x2C
+
+//Shield wiring on the Uno: D0-D1 on PB0-PB1, D2-D7 on PD2-PD7, and the control lines on port C
+#define LCD_RD_BIT 0x01 //A0
+#define LCD_WR_BIT 0x02 //A1
+#define LCD_CD_BIT 0x04 //A2
+#define LCD_CS_BIT 0x08 //A3
+
+#ifndef __AVR__
+//What the bus did, kept by the host build in place of the port writes
+struct LcdBusCountsStruct {
+    unsigned long strobes; //WR pulses, one per byte on the bus
+    unsigned long commands; //Bytes written with CD low
+    unsigned long dataLoads; //Times the data lines were set, a run of one repeated byte loads them once
+    unsigned long windows;
+};
+typedef struct LcdBusCountsStruct LcdBusCounts;
+
+extern LcdBusCounts lcdBusCounts;
+#endif
+
+//Takes the data lines and the control lines as outputs for drawing on a width by height screen
+//Call after the library has initialized the chip, the lines are left idle with the chip deselected
+void lcdBusInit(unsigned int width, unsigned int height);
+
+//Selects the chip and opens the window from x0, y0 to x1, y1 inclusive for a pixel stream, row by row
+void lcdStartWindow(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1);
+
+//Streams count pixels of one color into the open window
+void lcdPushColor(uint16_t color, unsigned long count);
+
+//Streams count pixels from pixels into the open window
+void lcdPushPixels(const uint16_t pixels[], unsigned int count);
+
+//Deselects the chip, the window stays set until the next one is opened
+void lcdEndWindow();
+
+//Fills a w by h rectangle at x, y with color
+void lcdFillRect(unsigned int x, unsigned int y, unsigned int w, unsigned int h, uint16_t color);
+
+//Streams one row of a 1 bit per pixel bitmap into the open window, most significant bit on the left
+//Each of the width bits is scale pixels wide, color where it is set and background where it is clear
+void lcdPushBitmapRow(const unsigned char bits[], unsigned int width, unsigned char scale, uint16_t color,
+                      uint16_t background);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LCDBUS_H
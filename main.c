@@ -6,7 +6,36 @@
 
 #include <Elegoo_GFX.h>    // Core graphics library
 #include <Elegoo_TFTLCD.h> // Hardware-specific library
-#include <limits.h> // Used for random number generation
+#include <limits.h> // Used for the history accumulator bounds
+#include <avr/sleep.h> // Idle sleep between task releases
+#include <avr/eeprom.h> // State checkpoints survive a reset
+#include "telemetry.h" // Telemetry batch encoding shared with the ground tools
+#include "frame.h" // Serial link framing shared with the ground tools
+#include "satellite_types.h" // Bool shared with the plain C modules
+#include "mission.h" // Power, thruster and thrust command models shared with the mission sweep
+#include "idle.h" // Duty cycle accounting shared with the schedule simulator
+#include "reactive.h" // Derived state that is recomputed only when its inputs change
+#include "protothread.h" // Tasks that yield between chunks of output
+#include "checkpoint.h" // Wear leveled state checkpoints
+#include "trace.h" // Scheduler timeline for the ground side trace export
+#include "metrics.h" // Counters and gauges dumped on request over the serial link
+#include "registry.h" // Task registry with a ready queue ordered by release time
+#include "lcdbus.h" // Direct port writes to the ILI9341 for the drawing the dashboard repeats
+#include "timebase.h" // Deadline comparisons and uptime that survive the millis() wrap
+
+//Uncomment to run tasks above TASK_PRIORITY_BACKGROUND from a 1ms timer interrupt so they preempt the task loop
+//#define USE_PREEMPTIVE_KERNEL
+
+//Uncomment to paint the free stack before every dispatch and record how deep each task reaches into it
+//Costs a pass over the free RAM per dispatch, so only use it to measure headroom
+//#define MEASURE_STACK_DEPTH
+
+//Uncomment to record task, idle, serial and tft events and send them in FRAME_TRACE frames whenever the buffer fills
+//Sending a full buffer holds the loop for about a quarter second at 9600 baud, so only use it to look at the timeline
+//#define USE_TRACE
+
+//Uncomment to start millis() a minute short of its wrap, to watch the scheduler cross it without waiting 49.7 days
+//#define START_NEAR_WRAP
 
 // The control pins for the LCD can be assigned to any digital or
 // analog pins...but we'll use the analog pins as this allows us to
@@ -42,23 +71,145 @@
 #define WHITE   0xFFFF
 #define ORANGE  0xFC00
 
+//Large enough for any unsigned long in decimal plus a decimal point and the terminator
+#define FORMAT_BUFFER_SIZE 12
+
+//Indexes into stringTable, every label and message the system prints lives in flash
+enum StringId {
+    STR_FUEL, STR_BATTERY,
+    STR_POWER_SUBSYSTEM_TASK, STR_THRUSTER_SUBSYSTEM_TASK, STR_SATELLITE_COMS_TASK, STR_CONSOLE_DISPLAY_TASK,
+    STR_WARNING_ALARM_TASK,
+    STR_SOLAR_PANEL_STATE, STR_BATTERY_LEVEL, STR_FUEL_LEVEL, STR_POWER_CONSUMPTION, STR_POWER_GENERATION,
+    STR_ON, STR_OFF, STR_FUEL_LOW, STR_BATTERY_LOW,
+    STR_TFT_SIZE, STR_CYCLE_DELAY,
+    STR_STATS, STR_STATS_DISPATCHES, STR_STATS_MISSES, STR_STATS_MAX_LATENESS, STR_STATS_HISTOGRAM,
+    STR_STATS_STACK, STR_STATS_STACK_FREE,
+    STR_DASHBOARD_DISPLAY_TASK, STR_GAUGE_BATTERY, STR_GAUGE_FUEL, STR_GAUGE_CONSUMPTION, STR_GAUGE_GENERATION,
+    STR_IDLE, STR_IDLE_SLEPT, STR_IDLE_DUTY,
+    STR_CHECKPOINT_RESTORED, STR_CHECKPOINT_MICROSECONDS,
+    STR_COUNT
+};
+typedef enum StringId StringId;
+
+const char strFuel[] PROGMEM = "FUEL";
+const char strBattery[] PROGMEM = "BATTERY";
+const char strPowerSubsystemTask[] PROGMEM = "powerSubsystemTask";
+const char strThrusterSubsystemTask[] PROGMEM = "thrusterSubsystemTask";
+const char strSatelliteComsTask[] PROGMEM = "satelliteComsTask";
+const char strConsoleDisplayTask[] PROGMEM = "consoleDisplayTask";
+const char strWarningAlarmTask[] PROGMEM = "warningAlarmTask";
+const char strSolarPanelState[] PROGMEM = "\tSolar Panel State: ";
+const char strBatteryLevel[] PROGMEM = "\tBattery Level: ";
+const char strFuelLevel[] PROGMEM = "\tFuel Level: ";
+const char strPowerConsumption[] PROGMEM = "\tPower Consumption: ";
+const char strPowerGeneration[] PROGMEM = "\tPower Generation: ";
+const char strOn[] PROGMEM = " ON";
+const char strOff[] PROGMEM = "OFF";
+const char strFuelLow[] PROGMEM = "Fuel Low!";
+const char strBatteryLow[] PROGMEM = "Battery Low!";
+const char strTftSize[] PROGMEM = "TFT size is ";
+const char strCycleDelay[] PROGMEM = " - cycle delay: ";
+const char strStats[] PROGMEM = "stats ";
+const char strStatsDispatches[] PROGMEM = " n=";
+const char strStatsMisses[] PROGMEM = " miss=";
+const char strStatsMaxLateness[] PROGMEM = " max=";
+const char strStatsHistogram[] PROGMEM = " h=";
+const char strStatsStack[] PROGMEM = " stack=";
+const char strStatsStackFree[] PROGMEM = "stack free=";
+const char strDashboardDisplayTask[] PROGMEM = "dashboardDisplayTask";
+const char strGaugeBattery[] PROGMEM = "Battery Level";
+const char strGaugeFuel[] PROGMEM = "Fuel Level";
+const char strGaugeConsumption[] PROGMEM = "Power Consumption";
+const char strGaugeGeneration[] PROGMEM = "Power Generation";
+const char strIdle[] PROGMEM = "idle";
+const char strIdleSlept[] PROGMEM = " slept=";
+const char strIdleDuty[] PROGMEM = " duty=";
+const char strCheckpointRestored[] PROGMEM = "checkpoint restored seq=";
+const char strCheckpointMicroseconds[] PROGMEM = " us=";
+
+//Must list the strings in StringId order
+const char *const stringTable[STR_COUNT] PROGMEM = {
+        strFuel, strBattery,
+        strPowerSubsystemTask, strThrusterSubsystemTask, strSatelliteComsTask, strConsoleDisplayTask,
+        strWarningAlarmTask,
+        strSolarPanelState, strBatteryLevel, strFuelLevel, strPowerConsumption, strPowerGeneration,
+        strOn, strOff, strFuelLow, strBatteryLow,
+        strTftSize, strCycleDelay,
+        strStats, strStatsDispatches, strStatsMisses, strStatsMaxLateness, strStatsHistogram,
+        strStatsStack, strStatsStackFree,
+        strDashboardDisplayTask, strGaugeBattery, strGaugeFuel, strGaugeConsumption, strGaugeGeneration,
+        strIdle, strIdleSlept, strIdleDuty,
+        strCheckpointRestored, strCheckpointMicroseconds
+};
+
+//The tft labels are the first LABEL_COUNT string ids
+#define LABEL_COUNT 2
+//Longest label in characters
+#define LABEL_MAX_CHARS 7
+//Size of one character cell of the 5x7 font before scaling
+#define GLYPH_WIDTH 6
+#define GLYPH_HEIGHT 8
+//Labels are drawn at twice the font size
+#define LABEL_SCALE 2
+#define LABEL_ROW_BYTES ((LABEL_MAX_CHARS * GLYPH_WIDTH + 7) / 8)
+
+//5x7 font columns for the characters used by the labels and the gauge readouts, least significant bit at the top
+//Same shapes as the library font so the labels look unchanged
+const unsigned char labelGlyphs[][6] PROGMEM = {
+        {'0', 0x3E, 0x51, 0x49, 0x45, 0x3E},
+        {'1', 0x00, 0x42, 0x7F, 0x40, 0x00},
+        {'2', 0x72, 0x49, 0x49, 0x49, 0x46},
+        {'3', 0x21, 0x41, 0x49, 0x4D, 0x33},
+        {'4', 0x18, 0x14, 0x12, 0x7F, 0x10},
+        {'5', 0x27, 0x45, 0x45, 0x45, 0x39},
+        {'6', 0x3C, 0x4A, 0x49, 0x49, 0x31},
+        {'7', 0x41, 0x21, 0x11, 0x09, 0x07},
+        {'8', 0x36, 0x49, 0x49, 0x49, 0x36},
+        {'9', 0x46, 0x49, 0x49, 0x29, 0x1E},
+        {'A', 0x7C, 0x12, 0x11, 0x12, 0x7C},
+        {'B', 0x7F, 0x49, 0x49, 0x49, 0x36},
+        {'E', 0x7F, 0x49, 0x49, 0x49, 0x41},
+        {'F', 0x7F, 0x09, 0x09, 0x09, 0x01},
+        {'L', 0x7F, 0x40, 0x40, 0x40, 0x40},
+        {'R', 0x7F, 0x09, 0x19, 0x29, 0x46},
+        {'T', 0x01, 0x01, 0x7F, 0x01, 0x01},
+        {'U', 0x3F, 0x40, 0x40, 0x40, 0x3F},
+        {'Y', 0x07, 0x08, 0x70, 0x08, 0x07}
+};
+
 Elegoo_TFTLCD tft(LCD_CS, LCD_CD, LCD_WR, LCD_RD, LCD_RESET);
 // If using the shield, all control and data lines are fixed, and
 // a simpler declaration can optionally be used:
 // Elegoo_TFTLCD tft;
-
-enum myBool {
-    FALSE = 0, TRUE = 1
-};
-typedef enum myBool Bool;
+//Set once the tft is known to be an ILI9341, the repeated drawing then goes through lcdbus instead of the library
+Bool LcdBusReady = FALSE;
 
 long runDelay = 5000;
-long randomGenerationSeed = 1000;
+int32_t randomGenerationSeed = 1000;
 Bool shouldPrintTaskTiming = TRUE;
+//Number of console display periods between full reprints of every field, 0 reprints every period
+unsigned int consoleKeyframeInterval = 12;
+//Milliseconds between compact scheduler statistics summaries on the serial port, 0 disables them
+unsigned long statsSummaryInterval = 60000;
+//Sleeps the processor between task releases instead of spinning on the clock
+Bool shouldSleepWhenIdle = TRUE;
+//Milliseconds the scheduler may sleep between passes while tasks that run on every pass are loaded
+//Bounds how late the alarm blinks and the dashboard redraws
+unsigned long idlePollInterval = 20;
+//Milliseconds between checkpoints of the spacecraft state in EEPROM, 0 disables them
+//An EEPROM byte takes about 3.4ms to write and a slot is 29 bytes, about 100ms when most of them change, so a save
+//writes CHECKPOINT_BYTES_PER_PASS bytes per scheduler pass and holds the loop for at most about 7ms at a time
+unsigned long checkpointInterval = 60000;
+#define CHECKPOINT_BYTES_PER_PASS 2
+//Sends encoded telemetry batches on the serial port
+Bool shouldSendTelemetry = TRUE;
+//Samples collected before a telemetry batch is encoded and sent, the encoded batch must fit a one byte length
+#define TELEMETRY_BATCH_SAMPLES 8
 
 
 //Thrust Control
 unsigned int ThrusterControl = 0;
+Bool ThrustCommandPending = FALSE; //Set when the ground sent the current ThrusterControl
 
 //Power Management
 unsigned short BatteryLevel = 100;
@@ -68,34 +219,169 @@ unsigned short PowerGeneration = 0;
 
 //Solar Panel Control
 Bool SolarPanelState = FALSE;
+PowerModelState PowerModel = {0, TRUE};
 
 //Status Management and Annunciation
 //Same as Power Management
+Bool InStatusMode = TRUE;
+
+//Uplink
+FrameRing UplinkRing;
+
+//Scheduler idle time since the last statistics summary
+IdleStats SchedulerIdle;
+
+//Spacecraft state checkpoints, rotated over the whole EEPROM
+CheckpointStore StateStore;
+
+//Counters and gauges for the ground, see metrics.h
+Metrics SystemMetrics;
+
+//Counts the millis() wraps for systemUptime
+TimeBase SystemTimeBase;
+
+#ifdef USE_TRACE
+//Timeline events waiting to be sent
+TraceBuffer Trace;
+#define TRACE(type, arg) trace(type, arg)
+#else
+#define TRACE(type, arg)
+#endif
 
 //Warning Alarm
 Bool FuelLow = FALSE;
 Bool BatteryLow = FALSE;
 
+//Derived warning state, connected by setupSignals
+//FuelLow and BatteryLow are kept up to date by subscribers of the low signals
+Signal FuelLevelSignal;
+Signal BatteryLevelSignal;
+Signal FuelLowSignal;
+Signal BatteryLowSignal;
+Signal FuelAlarmColor;
+Signal BatteryAlarmColor;
+Signal FuelBlinkDelay;
+Signal BatteryBlinkDelay;
+
+//Task priorities, a higher priority task preempts a lower one when the preemptive kernel is enabled
+#define TASK_PRIORITY_BACKGROUND 0
+#define TASK_PRIORITY_ALARM      1
+
+//Number of lateness histogram buckets, bucket i counts dispatches less than 2^i ms late and the last counts the rest
+#define LATENESS_BUCKETS 8
+
+//Dispatch statistics the scheduler keeps for every task
+struct TaskStatsStruct {
+    unsigned long dispatches;
+    unsigned long deadlineMisses; //Dispatches that finished after their next release was due
+    unsigned long maxLateness;
+    unsigned int latenessHistogram[LATENESS_BUCKETS];
+};
+typedef struct TaskStatsStruct TaskStats;
+
 struct TaskStruct {
     void (*task)(void *);
 
     void *taskDataPtr;
+
+    StringId name;
+
+    unsigned char priority;
+
+    unsigned long period; //Milliseconds between releases, 0 runs the task on every pass
+
+    ScheduleEntry entry; //Release time and place in the registry that runs the task
+
+    unsigned long lastRunTime;
+
+    TaskStats stats;
+
+    Protothread *thread; //Set for a task written as a protothread, it is run again on every pass until it finishes
+
+#ifdef MEASURE_STACK_DEPTH
+    unsigned int stackHighWaterMark; //Deepest stack use in bytes below the dispatcher, including interrupts
+#endif
+
+    unsigned char slot; //Order the task was added in, names the task in metrics and trace events
 };
 
 typedef struct TaskStruct TCB;
 
+//Tasks the scheduler loop runs
+TaskRegistry SchedulerTasks;
+
+#ifdef USE_PREEMPTIVE_KERNEL
+//Tasks the kernel tick runs, KernelTasks[priority - 1] for each priority above TASK_PRIORITY_BACKGROUND
+//Only changed before the tick starts
+TaskRegistry KernelTasks[TASK_PRIORITY_ALARM];
+#endif
+
+//Entries kept per history tier, sized so the four histories fit in about 500 bytes of RAM
+#define HISTORY_RAW_SAMPLES 8
+#define HISTORY_MINUTES 10
+#define HISTORY_HOURS 6
+#define HISTORY_MINUTE_LENGTH 60000UL
+#define HISTORY_MINUTES_PER_HOUR 60
+
+//Resolutions a history can be queried at
+enum HistoryTier {
+    HISTORY_RAW, HISTORY_MINUTE, HISTORY_HOUR
+};
+typedef enum HistoryTier HistoryTier;
+
+//Summary of the samples in one history entry, a raw sample has min = max = avg
+struct AggregateStruct {
+    unsigned short min;
+    unsigned short max;
+    unsigned short avg;
+};
+typedef struct AggregateStruct Aggregate;
+
+//Running summary of the entry currently being filled
+struct AccumulatorStruct {
+    unsigned short min;
+    unsigned short max;
+    unsigned long sum;
+    unsigned int count;
+    unsigned long startTime;
+};
+typedef struct AccumulatorStruct Accumulator;
+
+//Fixed size multi resolution history of one value, each tier is a ring that overwrites its oldest entry
+struct HistoryStruct {
+    unsigned short raw[HISTORY_RAW_SAMPLES];
+    Aggregate minutes[HISTORY_MINUTES];
+    Aggregate hours[HISTORY_HOURS];
+    unsigned char rawCount, rawNext;
+    unsigned char minuteCount, minuteNext;
+    unsigned char hourCount, hourNext;
+    Accumulator minute; //Raw samples of the current minute
+    Accumulator hour; //Minute averages of the current hour
+};
+typedef struct HistoryStruct History;
+
+//Telemetry History
+History BatteryHistory;
+History FuelHistory;
+History ConsumptionHistory;
+History GenerationHistory;
 
 struct PowerSubsystemDataStruct {
+    PowerModelState *model;
     Bool *solarPanelState;
     unsigned short *batteryLevel;
     unsigned short *powerConsumption;
     unsigned short *powerGeneration;
+    History *batteryHistory;
+    History *consumptionHistory;
+    History *generationHistory;
 };
 typedef struct PowerSubsystemDataStruct PowerSubsystemData;
 
 struct ThrusterSubsystemDataStruct {
     unsigned int *thrusterControl;
     unsigned short *fuelLevel;
+    History *fuelHistory;
 };
 typedef struct ThrusterSubsystemDataStruct ThrusterSubsystemData;
 
@@ -108,10 +394,17 @@ struct SatelliteComsDataStruct {
     unsigned short *powerConsumption;
     unsigned short *powerGeneration;
     unsigned int *thrusterControl;
+    Bool *thrustCommandPending;
+    History *batteryHistory;
+    History *fuelHistory;
+    History *consumptionHistory;
+    History *generationHistory;
 };
 typedef struct SatelliteComsDataStruct SatelliteComsData;
 
 struct ConsoleDisplayDataStruct {
+    Protothread thread;
+    Bool *inStatusMode;
     Bool *fuelLow;
     Bool *batteryLow;
     Bool *solarPanelState;
@@ -123,12 +416,89 @@ struct ConsoleDisplayDataStruct {
 typedef struct ConsoleDisplayDataStruct ConsoleDisplayData;
 
 struct WarningAlarmDataStruct {
-    Bool *fuelLow;
-    Bool *batteryLow;
+    Signal *fuelColor;
+    Signal *fuelDelay;
+    Signal *batteryColor;
+    Signal *batteryDelay;
+};
+typedef struct WarningAlarmDataStruct WarningAlarmData;
+
+struct DashboardDisplayDataStruct {
     unsigned short *batteryLevel;
     unsigned short *fuelLevel;
+    unsigned short *powerConsumption;
+    unsigned short *powerGeneration;
+};
+typedef struct DashboardDisplayDataStruct DashboardDisplayData;
+
+//Dashboard layout, one gauge per row below the warning labels
+#define DASHBOARD_GAUGES 4
+#define DASHBOARD_TOP 48
+#define GAUGE_ROW_HEIGHT 40
+#define GAUGE_BAR_OFFSET 10 //Below the caption
+#define GAUGE_BAR_WIDTH 180
+#define GAUGE_BAR_HEIGHT 16
+#define GAUGE_READOUT_X 190
+
+//What a gauge shows, kept in flash
+struct GaugeLayoutStruct {
+    StringId caption;
+    unsigned short fullScale;
+    unsigned int color;
+};
+typedef struct GaugeLayoutStruct GaugeLayout;
+
+//In the order dashboardDisplayTask reads the values
+const GaugeLayout gaugeLayouts[DASHBOARD_GAUGES] PROGMEM = {
+        {STR_GAUGE_BATTERY,     100, CYAN},
+        {STR_GAUGE_FUEL,        100, YELLOW},
+        {STR_GAUGE_CONSUMPTION, 20,  MAGENTA},
+        {STR_GAUGE_GENERATION,  50,  BLUE}
 };
-typedef struct WarningAlarmDataStruct WarningAlarmData;
+
+//What a gauge currently has on screen
+struct GaugeStateStruct {
+    Bool drawn; //Caption and frame are on screen
+    int filledWidth;
+    unsigned short shownValue;
+};
+typedef struct GaugeStateStruct GaugeState;
+
+//Bit flags for the fields followed by a change tracker
+#define CHANGED_SOLAR_PANEL_STATE 0x01
+#define CHANGED_BATTERY_LEVEL     0x02
+#define CHANGED_FUEL_LEVEL        0x04
+#define CHANGED_POWER_CONSUMPTION 0x08
+#define CHANGED_POWER_GENERATION  0x10
+#define CHANGED_FUEL_LOW          0x20
+#define CHANGED_BATTERY_LOW       0x40
+#define CHANGED_ALL               0x7F
+#define CHANGED_VALUES            0x1F //The fields status mode prints
+#define CHANGED_LOW_FLAGS         0x60 //The warnings printed outside status mode
+
+//Remembers the last values an output path emitted so unchanged values can be skipped
+struct ChangeTrackerStruct {
+    Bool solarPanelState;
+    unsigned short batteryLevel;
+    unsigned short fuelLevel;
+    unsigned short powerConsumption;
+    unsigned short powerGeneration;
+    Bool fuelLow;
+    Bool batteryLow;
+    unsigned int periodsSinceKeyframe;
+    Bool hasEmitted;
+};
+typedef struct ChangeTrackerStruct ChangeTracker;
+
+//A label rasterized once at font size into a 1 bit per pixel bitmap, most significant bit on the left
+struct LabelBitmapStruct {
+    Bool rasterized;
+    unsigned char width; //Pixels before scaling
+    unsigned char rows[GLYPH_HEIGHT][LABEL_ROW_BYTES];
+};
+typedef struct LabelBitmapStruct LabelBitmap;
+
+LabelBitmap labelCache[LABEL_COUNT];
 
 
 //Controls the execution of the power subsystem
@@ -146,27 +516,210 @@ void consoleDisplayTask(void *consoleDisplayData);
 //Controls the execution of the warning alarm subsystem
 void warningAlarmTask(void *warningAlarmData);
 
+//Controls the execution of the tft dashboard, redraws at most one gauge per call
+void dashboardDisplayTask(void *dashboardDisplayData);
+
+//Brings one gauge on the tft up to date with value, drawing only the part of the bar that changed
+void updateGauge(unsigned int index, GaugeState *gauge, unsigned short value);
+
+//Adds a sample taken at time to a history, closing minute and hour entries as their time runs out
+void recordSample(History *history, unsigned short value, unsigned long time);
+
+//Starts an accumulator over at time
+void resetAccumulator(Accumulator *accumulator, unsigned long time);
+
+//Adds a value to an accumulator
+void accumulate(Accumulator *accumulator, unsigned short min, unsigned short max, unsigned short value);
+
+//Returns the summary of everything added to an accumulator
+Aggregate closeAccumulator(Accumulator *accumulator);
+
+//Returns the number of entries a history tier holds
+unsigned int historyLength(History *history, HistoryTier tier);
+
+//Copies the entry age steps back from the newest (age 0) of a history tier into entry
+//Returns FALSE if the tier does not hold that many entries
+Bool historyEntry(History *history, HistoryTier tier, unsigned int age, Aggregate *entry);
+
+//Returns the newest raw sample of a history, or fallback if it has none yet
+unsigned short latestSample(History *history, unsigned short fallback);
+
+//Encodes a batch of telemetry samples and writes it to the serial port as one frame
+void sendTelemetryBatch(unsigned short samples[][TELEMETRY_CHANNELS], int count);
+
+//Writes one frame to the serial port straight from the payload buffer
+void sendFrame(unsigned char type, const unsigned char payload[], unsigned char length);
+
+//Moves bytes the serial port has received into the uplink ring
+void receiveUplink(FrameRing *ring);
+
+//Dispatches every complete uplink frame waiting in the ring
+void serviceUplink(FrameRing *ring);
+
+//Applies one uplink command, reading its payload in place
+void dispatchUplinkFrame(const FrameView *frame);
+
+//Samples the gauges and sends every metric in a FRAME_METRICS frame
+void sendMetrics();
+
+//Keeps the preemptive kernel from running tft tasks until unlockDisplay, returns what to pass to unlockDisplay
+unsigned char lockDisplay();
+
+//Lets tasks preempted by lockDisplay run again
+void unlockDisplay(unsigned char previousPriority);
+
 //Returns a random integer between low and high inclusively
 int randomInteger(int low, int high);
 
-//Runs the loop of all six tasks, does not run the task if the task pointer is null
-void scheduleTask(TCB *tasks[6]);
+//Runs the released tasks of SchedulerTasks forever, sleeping between releases when shouldSleepWhenIdle is set
+void scheduleTask();
+
+//Registers a task with the registry that runs it, returns FALSE if that registry is full
+Bool addTask(TCB *task);
+
+//Runs every task of registry that is released now and queues each again at its next release
+Bool runReleasedTasks(TaskRegistry *registry);
+
+//Fills in a task control block, the first release is immediate
+void initTask(TCB *task, StringId name, void (*function)(void *), void *taskData, unsigned char priority,
+              unsigned long period);
+
+//Runs a task taken from its registry and records how late it started against its release
+void dispatchTask(TCB *task);
+
+//Copies the dispatch statistics of a task into stats
+void getTaskStats(TCB *task, TaskStats *stats);
+
+//Clears the dispatch statistics of a task
+void resetTaskStats(TCB *task);
+
+//Prints one compact line of dispatch statistics per task
+void printTaskStats();
+
+//Prints the dispatch statistics line of every task in registry
+void printRegistryStats(TaskRegistry *registry);
+
+//Returns when the scheduler next has work, the earliest release of a task it runs, nextSummaryTime or nextCheckpointTime
+unsigned long nextWakeTime(unsigned long nextSummaryTime, unsigned long nextCheckpointTime, Bool threadRunning);
+
+//Sleeps until wakeTime or until an uplink byte arrives and records the time slept
+void idleUntil(unsigned long wakeTime);
+
+//Prints the idle statistics since the last call and starts a new window
+void printIdleStats();
+
+#ifdef USE_TRACE
+//Records a trace event at the current time, safe to call from the kernel tick
+void trace(unsigned char type, unsigned char arg);
+
+//Sends the trace buffer in FRAME_TRACE frames and starts a new window
+void sendTrace();
+#endif
+
+//Returns the lowest address the stack can grow down to
+char *stackLimit();
+
+//Fills the free stack below the caller with STACK_PAINT
+void paintStack();
+
+//Returns the lowest stack address that no longer holds STACK_PAINT
+char *lowestStackUse();
+
+//Starts the 1ms timer tick that runs the tasks above TASK_PRIORITY_BACKGROUND
+void startKernelTick();
+
+//Runs every task whose priority is above the priority of the code the tick interrupted, highest first
+void kernelTick();
+
+//Prints a string table entry to the tft given the string, a color, and a line number
+void print(StringId str, int color, int line);
+
+//Returns a string table entry in the form Serial.print expects for flash strings
+const __FlashStringHelper *flashString(StringId id);
+
+//Returns the cached bitmap of a label, rasterizing it on first use
+LabelBitmap *cachedLabel(StringId label);
+
+//Sets the bits of character c's glyph in the cell at index of rows, a 1 bit per pixel bitmap rowBytes wide
+void rasterizeGlyph(char c, int index, unsigned char *rows, int rowBytes);
+
+//Draws text at LABEL_SCALE with its top left corner at x, y, over a background color
+void drawText(const char *text, int x, int y, int color, int background);
 
-//Prints a string to the tft given text, the length of the text, a color, and a line number
-void print(char str[], int length, int color, int line);
+//Fills a rectangle of the tft with a color
+void fillArea(int x, int y, int w, int h, int color);
 
 //Starts up the system by creating all the objects that are needed to run the system
 void setupSystem();
 
-//Prints timing information for a function based on its last runtime
-void printTaskTiming(char taskName[], unsigned long lastRunTime);
+//Connects the derived warning signals to the levels they follow
+void setupSignals();
+
+//Restores the spacecraft state from the newest EEPROM checkpoint, if there is one
+void restoreSystemCheckpoint();
+
+//Writes the next few bytes of a checkpoint of the spacecraft state, returns TRUE once it is complete
+Bool saveSystemCheckpoint();
+
+//Copies the spacecraft state into mission
+void captureMissionState(MissionState *mission);
+
+//Sets the spacecraft state from mission
+void applyMissionState(const MissionState *mission);
+
+//Reads length bytes of EEPROM at address into buffer
+void eepromRead(unsigned int address, void *buffer, unsigned int length, void *context);
+
+//Writes length bytes of buffer to EEPROM at address, skipping bytes that already hold the value
+void eepromWrite(unsigned int address, const void *buffer, unsigned int length, void *context);
+
+//Returns 1 if a level is low enough to raise its warning
+unsigned short lowLevel(const unsigned short inputs[]);
+
+//Returns the alarm color of a level given the level and its low signal
+unsigned short alarmColor(const unsigned short inputs[]);
+
+//Returns the fuel alarm blink delay in milliseconds given the fuel low signal
+unsigned short fuelBlinkDelay(const unsigned short inputs[]);
+
+//Returns the battery alarm blink delay in milliseconds given the battery low signal
+unsigned short batteryBlinkDelay(const unsigned short inputs[]);
+
+//Subscriber that keeps the Bool in context equal to a signal
+void storeFlag(unsigned short value, void *context);
+
+//Prints timing information for a function given the milliseconds since it last ran
+void printTaskTiming(StringId taskName, unsigned long delay);
 
 //Returns the current system time in milliseconds
 unsigned long systemTime();
 
+//Returns the milliseconds since power on extended to 64 bits, so they never wrap
+uint64_t systemUptime();
+
+//Returns the CHANGED_* flags of the values that differ from the last emitted ones, or CHANGED_ALL when a keyframe is due
+//The given values are recorded as emitted
+unsigned char trackChanges(ChangeTracker *tracker, unsigned int keyframeInterval, Bool solarPanelState,
+                           unsigned short batteryLevel, unsigned short fuelLevel, unsigned short powerConsumption,
+                           unsigned short powerGeneration, Bool fuelLow, Bool batteryLow);
+
+//Writes value in decimal into buffer, zero padded to at least width digits, and returns the number of characters written
+//buffer must hold FORMAT_BUFFER_SIZE characters
+int formatUnsigned(char buffer[], unsigned long value, int width);
+
+//Writes a fixed point value with fractionDigits digits after the decimal point into buffer, ie 1234 with 3 digits is 1.234
+//Returns the number of characters written, buffer must hold FORMAT_BUFFER_SIZE characters
+int formatFixedPoint(char buffer[], unsigned long value, int fractionDigits);
+
 
 //Arduino setup function
 void setup(void) {
+#ifdef START_NEAR_WRAP
+    extern volatile unsigned long timer0_millis; //The Arduino core's millis() count
+    noInterrupts();
+    timer0_millis = TIME_NEAR_WRAP;
+    interrupts();
+#endif
     Serial.begin(9600); //Sets baud rate to 9600
     Serial.println(F("TFT LCD test")); //Prints to serial monitor
 
@@ -178,10 +731,13 @@ void setup(void) {
 #endif
 
     //prints out tft size
-    Serial.print("TFT size is ");
-    Serial.print(tft.width());
-    Serial.print("x");
-    Serial.println(tft.height());
+    char number[FORMAT_BUFFER_SIZE];
+    Serial.print(flashString(STR_TFT_SIZE));
+    formatUnsigned(number, tft.width(), 1);
+    Serial.print(number);
+    Serial.print('x');
+    formatUnsigned(number, tft.height(), 1);
+    Serial.println(number);
 
     tft.reset();
     tft.setTextSize(2);
@@ -219,6 +775,10 @@ void setup(void) {
     }
     tft.begin(identifier);
     tft.fillScreen(NONE);
+    if (identifier == 0x9341) {
+        lcdBusInit(tft.width(), tft.height());
+        LcdBusReady = TRUE;
+    }
 
 }
 
@@ -229,7 +789,15 @@ void loop(void) {
 
 //Starts up the system by creating all the objects that are needed to run the system
 void setupSystem() {
-    TCB *queue[6];
+    initTimeBase(&SystemTimeBase, systemTime());
+    restoreSystemCheckpoint();
+
+    initTaskRegistry(&SchedulerTasks);
+#ifdef USE_PREEMPTIVE_KERNEL
+    for (unsigned char level = TASK_PRIORITY_ALARM; level > TASK_PRIORITY_BACKGROUND; level--) {
+        initTaskRegistry(&KernelTasks[level - 1]);
+    }
+#endif
 
     /*
      * Init the various tasks
@@ -238,31 +806,35 @@ void setupSystem() {
     //Power Subsystem
     TCB powerSubsystem;
     PowerSubsystemData powerSubsystemData;
+    powerSubsystemData.model = &PowerModel;
     powerSubsystemData.solarPanelState = &SolarPanelState;
     powerSubsystemData.batteryLevel = &BatteryLevel;
     powerSubsystemData.powerConsumption = &PowerConsumption;
     powerSubsystemData.powerGeneration = &PowerGeneration;
+    powerSubsystemData.batteryHistory = &BatteryHistory;
+    powerSubsystemData.consumptionHistory = &ConsumptionHistory;
+    powerSubsystemData.generationHistory = &GenerationHistory;
 
-    powerSubsystem.taskDataPtr = (void *) &powerSubsystemData;
-    powerSubsystem.task = &powerSubsystemTask;
+    initTask(&powerSubsystem, STR_POWER_SUBSYSTEM_TASK, &powerSubsystemTask, (void *) &powerSubsystemData, TASK_PRIORITY_BACKGROUND, runDelay);
 
-    queue[0] = &powerSubsystem;
+    addTask(&powerSubsystem);
 
     //Thruster Subsystem
     TCB thrusterSubsystem;
     ThrusterSubsystemData thrusterSubsystemData;
     thrusterSubsystemData.fuelLevel = &FuelLevel;
     thrusterSubsystemData.thrusterControl = &ThrusterControl;
+    thrusterSubsystemData.fuelHistory = &FuelHistory;
 
-    thrusterSubsystem.taskDataPtr = (void *) &thrusterSubsystemData;
-    thrusterSubsystem.task = &thrusterSubsystemTask;
+    initTask(&thrusterSubsystem, STR_THRUSTER_SUBSYSTEM_TASK, &thrusterSubsystemTask, (void *) &thrusterSubsystemData, TASK_PRIORITY_BACKGROUND, runDelay);
 
-    queue[1] = &thrusterSubsystem;
+    addTask(&thrusterSubsystem);
 
     //Satellite Comms
     TCB satelliteComs;
     SatelliteComsData satelliteComsData;
     satelliteComsData.thrusterControl = &ThrusterControl;
+    satelliteComsData.thrustCommandPending = &ThrustCommandPending;
     satelliteComsData.fuelLevel = &FuelLevel;
     satelliteComsData.powerGeneration = &PowerGeneration;
     satelliteComsData.powerConsumption = &PowerConsumption;
@@ -270,15 +842,19 @@ void setupSystem() {
     satelliteComsData.solarPanelState = &SolarPanelState;
     satelliteComsData.batteryLow = &BatteryLow;
     satelliteComsData.fuelLow = &FuelLow;
+    satelliteComsData.batteryHistory = &BatteryHistory;
+    satelliteComsData.fuelHistory = &FuelHistory;
+    satelliteComsData.consumptionHistory = &ConsumptionHistory;
+    satelliteComsData.generationHistory = &GenerationHistory;
 
-    satelliteComs.taskDataPtr = (void *) &satelliteComsData;
-    satelliteComs.task = &satelliteComsTask;
+    initTask(&satelliteComs, STR_SATELLITE_COMS_TASK, &satelliteComsTask, (void *) &satelliteComsData, TASK_PRIORITY_BACKGROUND, runDelay);
 
-    queue[2] = &satelliteComs;
+    addTask(&satelliteComs);
 
     //Console Display
     TCB consoleDisplay;
     ConsoleDisplayData consoleDisplayData;
+    consoleDisplayData.inStatusMode = &InStatusMode;
     consoleDisplayData.fuelLow = &FuelLow;
     consoleDisplayData.batteryLow = &BatteryLow;
     consoleDisplayData.solarPanelState = &SolarPanelState;
@@ -287,238 +863,828 @@ void setupSystem() {
     consoleDisplayData.powerConsumption = &PowerConsumption;
     consoleDisplayData.powerGeneration = &PowerGeneration;
 
-    consoleDisplay.taskDataPtr = (void *) &consoleDisplayData;
-    consoleDisplay.task = &consoleDisplayTask;
+    initTask(&consoleDisplay, STR_CONSOLE_DISPLAY_TASK, &consoleDisplayTask, (void *) &consoleDisplayData, TASK_PRIORITY_BACKGROUND, runDelay);
+    PT_INIT(&consoleDisplayData.thread);
+    consoleDisplay.thread = &consoleDisplayData.thread;
 
-    queue[3] = &consoleDisplay;
+    addTask(&consoleDisplay);
 
     //Warning Alarm
     TCB warningAlarm;
     WarningAlarmData warningAlarmData;
-    warningAlarmData.batteryLevel = &BatteryLevel;
-    warningAlarmData.batteryLow = &BatteryLow;
-    warningAlarmData.fuelLow = &FuelLow;
-    warningAlarmData.fuelLevel = &FuelLevel;
+    setupSignals();
+    warningAlarmData.fuelColor = &FuelAlarmColor;
+    warningAlarmData.fuelDelay = &FuelBlinkDelay;
+    warningAlarmData.batteryColor = &BatteryAlarmColor;
+    warningAlarmData.batteryDelay = &BatteryBlinkDelay;
+
+    //Runs on every pass, blinking must not wait on the serial output
+    initTask(&warningAlarm, STR_WARNING_ALARM_TASK, &warningAlarmTask, (void *) &warningAlarmData, TASK_PRIORITY_ALARM, 0);
+
+    addTask(&warningAlarm);
+
+    //Dashboard Display
+    TCB dashboardDisplay;
+    DashboardDisplayData dashboardDisplayData;
+    dashboardDisplayData.batteryLevel = &BatteryLevel;
+    dashboardDisplayData.fuelLevel = &FuelLevel;
+    dashboardDisplayData.powerConsumption = &PowerConsumption;
+    dashboardDisplayData.powerGeneration = &PowerGeneration;
 
-    warningAlarm.taskDataPtr = (void *) &warningAlarmData;
-    warningAlarm.task = &warningAlarmTask;
+    //Runs on every pass and spreads its drawing over passes, one gauge at a time
+    initTask(&dashboardDisplay, STR_DASHBOARD_DISPLAY_TASK, &dashboardDisplayTask, (void *) &dashboardDisplayData,
+             TASK_PRIORITY_BACKGROUND, 0);
 
-    queue[4] = &warningAlarm;
-    queue[5] = 0x0;
+    addTask(&dashboardDisplay);
+
+#ifdef USE_PREEMPTIVE_KERNEL
+    startKernelTick();
+#endif
 
     //Starts the schedule looping
-    scheduleTask(queue);
+    scheduleTask();
+}
+
+//Restores the spacecraft state from the newest EEPROM checkpoint, if there is one
+//Reads about three bytes per slot and one record, a few milliseconds at most, and prints how long it took
+void restoreSystemCheckpoint() {
+    unsigned long start = micros();
+    MissionState mission;
+    unsigned char snapshot[MISSION_SNAPSHOT_SIZE];
+    initCheckpointStore(&StateStore, E2END + 1, &eepromRead, &eepromWrite, 0x0);
+    if (!loadCheckpoint(&StateStore, snapshot, MISSION_SNAPSHOT_SIZE)) { //First boot, keep the defaults
+        return;
+    }
+    if (!decodeMissionSnapshot(snapshot, &mission)) { //Saved by a build with another layout, keep the defaults
+        return;
+    }
+    applyMissionState(&mission);
+    unsigned long elapsed = micros() - start;
+
+    char number[FORMAT_BUFFER_SIZE];
+    Serial.print(flashString(STR_CHECKPOINT_RESTORED));
+    formatUnsigned(number, StateStore.sequence, 1);
+    Serial.print(number);
+    Serial.print(flashString(STR_CHECKPOINT_MICROSECONDS));
+    formatUnsigned(number, elapsed, 1);
+    Serial.println(number);
+}
+
+//Writes the next few bytes of a checkpoint of the spacecraft state, returns TRUE once it is complete
+//A checkpoint is started from the current state when none is in progress. It is stored as a mission snapshot, whose
+//fixed little endian layout and version byte a reflash cannot silently reinterpret
+Bool saveSystemCheckpoint() {
+    static unsigned char snapshot[MISSION_SNAPSHOT_SIZE]; //Kept unchanged while the save is spread over passes
+    if (!checkpointPending(&StateStore)) {
+        MissionState mission;
+        captureMissionState(&mission);
+        encodeMissionSnapshot(&mission, snapshot);
+        beginCheckpoint(&StateStore, snapshot, MISSION_SNAPSHOT_SIZE);
+    }
+    if (!continueCheckpoint(&StateStore, CHECKPOINT_BYTES_PER_PASS)) {
+        return FALSE;
+    }
+    addMetric(&SystemMetrics, METRIC_CHECKPOINTS, 1);
+    return TRUE;
+}
+
+//Copies the spacecraft state into mission
+//The kernel tick may be running the alarm, which writes FuelLow and BatteryLow, so the copy is taken in one piece
+void captureMissionState(MissionState *mission) {
+    noInterrupts();
+    mission->batteryLevel = BatteryLevel;
+    mission->fuelLevel = FuelLevel;
+    mission->powerConsumption = PowerConsumption;
+    mission->powerGeneration = PowerGeneration;
+    mission->solarPanelState = SolarPanelState;
+    mission->fuelLow = FuelLow;
+    mission->batteryLow = BatteryLow;
+    mission->thrusterControl = ThrusterControl;
+    mission->power = PowerModel;
+    mission->randomSeed = randomGenerationSeed;
+    mission->periods = 0;
+    interrupts();
+}
+
+//Sets the spacecraft state from mission
+void applyMissionState(const MissionState *mission) {
+    BatteryLevel = mission->batteryLevel;
+    FuelLevel = mission->fuelLevel;
+    PowerConsumption = mission->powerConsumption;
+    PowerGeneration = mission->powerGeneration;
+    SolarPanelState = mission->solarPanelState;
+    FuelLow = mission->fuelLow;
+    BatteryLow = mission->batteryLow;
+    ThrusterControl = mission->thrusterControl;
+    PowerModel = mission->power;
+    randomGenerationSeed = mission->randomSeed;
+}
+
+//Reads length bytes of EEPROM at address into buffer
+void eepromRead(unsigned int address, void *buffer, unsigned int length, void *context) {
+    eeprom_read_block(buffer, (const void *) address, length);
+}
+
+//Writes length bytes of buffer to EEPROM at address, skipping bytes that already hold the value
+void eepromWrite(unsigned int address, const void *buffer, unsigned int length, void *context) {
+    eeprom_update_block(buffer, (void *) address, length);
+}
+
+//Connects the derived warning signals to the levels they follow
+void setupSignals() {
+    initSourceSignal(&FuelLevelSignal, &FuelLevel);
+    initSourceSignal(&BatteryLevelSignal, &BatteryLevel);
+
+    Signal *fuelLevel[] = {&FuelLevelSignal};
+    initDerivedSignal(&FuelLowSignal, &lowLevel, fuelLevel, 1);
+    subscribeSignal(&FuelLowSignal, &storeFlag, (void *) &FuelLow);
+    Signal *batteryLevel[] = {&BatteryLevelSignal};
+    initDerivedSignal(&BatteryLowSignal, &lowLevel, batteryLevel, 1);
+    subscribeSignal(&BatteryLowSignal, &storeFlag, (void *) &BatteryLow);
+
+    Signal *fuelInputs[] = {&FuelLevelSignal, &FuelLowSignal};
+    initDerivedSignal(&FuelAlarmColor, &alarmColor, fuelInputs, 2);
+    Signal *batteryInputs[] = {&BatteryLevelSignal, &BatteryLowSignal};
+    initDerivedSignal(&BatteryAlarmColor, &alarmColor, batteryInputs, 2);
+
+    Signal *fuelLow[] = {&FuelLowSignal};
+    initDerivedSignal(&FuelBlinkDelay, &fuelBlinkDelay, fuelLow, 1);
+    Signal *batteryLow[] = {&BatteryLowSignal};
+    initDerivedSignal(&BatteryBlinkDelay, &batteryBlinkDelay, batteryLow, 1);
+}
+
+//Returns 1 if a level is low enough to raise its warning
+unsigned short lowLevel(const unsigned short inputs[]) {
+    return inputs[0] <= MISSION_LOW_LEVEL ? 1 : 0;
+}
+
+//Returns the alarm color of a level given the level and its low signal
+//Green above half, then orange, then red once low
+unsigned short alarmColor(const unsigned short inputs[]) {
+    if (inputs[1]) {
+        return RED;
+    }
+    return inputs[0] <= 50 ? ORANGE : GREEN;
+}
+
+//Returns the fuel alarm blink delay in milliseconds given the fuel low signal
+unsigned short fuelBlinkDelay(const unsigned short inputs[]) {
+    return inputs[0] ? 2000 : 1000;
+}
+
+//Returns the battery alarm blink delay in milliseconds given the battery low signal
+unsigned short batteryBlinkDelay(const unsigned short inputs[]) {
+    return inputs[0] ? 1000 : 2000;
 }
 
-//Runs the loop of all six tasks, does not run the task if the task pointer is null
-void scheduleTask(TCB *tasks[6]) {
-    unsigned int currentTaskIndex = 0;
+//Subscriber that keeps the Bool in context equal to a signal
+void storeFlag(unsigned short value, void *context) {
+    *(Bool *) context = value ? TRUE : FALSE;
+}
+
+//Runs the released tasks of SchedulerTasks forever, sleeping between releases when shouldSleepWhenIdle is set
+//Tasks above TASK_PRIORITY_BACKGROUND are registered with the kernel tick instead when the preemptive kernel is enabled
+void scheduleTask() {
+    unsigned long nextSummaryTime = systemTime() + statsSummaryInterval;
+    unsigned long nextCheckpointTime = systemTime() + checkpointInterval;
+    resetIdleStats(&SchedulerIdle, micros());
     while (1) { //Loop forever
         //Major cycle
-        while (currentTaskIndex < 6) {
-            TCB *task = tasks[currentTaskIndex];
-            if (task != 0x0) { //Filter out null tasks
-                task->task(task->taskDataPtr);
-            }
-            currentTaskIndex++;
+        Bool threadRunning = runReleasedTasks(&SchedulerTasks);
+#ifndef USE_PREEMPTIVE_KERNEL
+        receiveUplink(&UplinkRing); //Otherwise the kernel tick keeps the ring fed
+#endif
+        serviceUplink(&UplinkRing);
+        systemUptime(); //Every pass is far more often than once per wrap, so no wrap is missed
+        if (statsSummaryInterval > 0 && timeBefore(nextSummaryTime, systemTime())) {
+            printTaskStats();
+            printIdleStats();
+            nextSummaryTime = systemTime() + statsSummaryInterval;
+        }
+#ifdef USE_TRACE
+        if (traceFull(&Trace)) {
+            sendTrace();
+        }
+#endif
+        //A save in progress keeps nextCheckpointTime in the past, so the scheduler does not sleep until it is done
+        if (checkpointInterval > 0 && timeBefore(nextCheckpointTime, systemTime()) && saveSystemCheckpoint()) {
+            nextCheckpointTime = systemTime() + checkpointInterval;
+        }
+        if (shouldSleepWhenIdle) {
+            idleUntil(nextWakeTime(nextSummaryTime, nextCheckpointTime, threadRunning));
         }
-        currentTaskIndex = 0;
     }
 }
 
-//Controls the execution of the power subsystem
-void powerSubsystemTask(void *powerSubsystemData) {
-    //Count of the number times this function is called.
-    // It is okay if this number wraps to 0 because we just care about if the function call is odd or even
-    static unsigned long nextExecutionTime = 0;
-    static unsigned long lastExecutionTime = 0;
-    if (nextExecutionTime == 0 || systemTime() > nextExecutionTime) {
-        printTaskTiming("powerSubsystemTask", lastExecutionTime);
-        lastExecutionTime = systemTime();
-        PowerSubsystemData *data = (PowerSubsystemData *) powerSubsystemData;
-        static unsigned int executionCount = 0;
-        //powerConsumption
-        static Bool consumptionIncreasing = TRUE;
-        if (consumptionIncreasing) {
-            if (executionCount % 2 == 0) {
-                *(data->powerConsumption) += 2;
-            } else {
-                *(data->powerConsumption) -= 1;
-            }
-            if (*(data->powerConsumption) > 10) {
-                consumptionIncreasing = FALSE;
-            }
-        } else {
-            if (executionCount % 2 == 0) {
-                *(data->powerConsumption) -= 2;
-            } else {
-                *(data->powerConsumption) += 1;
-            }
-            if (*(data->powerConsumption) < 5) {
-                consumptionIncreasing = TRUE;
+//Registers a task with the registry that runs it, returns FALSE if that registry is full
+//Tasks above TASK_PRIORITY_BACKGROUND go to the kernel tick when the preemptive kernel is enabled, before it starts
+Bool addTask(TCB *task) {
+    static unsigned char nextSlot = 0;
+    TaskRegistry *registry = &SchedulerTasks;
+#ifdef USE_PREEMPTIVE_KERNEL
+    if (task->priority > TASK_PRIORITY_BACKGROUND) {
+        registry = &KernelTasks[task->priority - 1];
+    }
+#endif
+    if (!registerTask(registry, &task->entry, task)) {
+        return FALSE;
+    }
+    task->slot = nextSlot++;
+    return TRUE;
+}
+
+//Runs every task of registry that is released now and queues each again at its next release
+//Returns TRUE if a protothread yielded with work left
+//Costs O(log n) per task run, tasks that are not released are never looked at
+Bool runReleasedTasks(TaskRegistry *registry) {
+    Bool threadRunning = FALSE;
+    ScheduleEntry *entry = takeReleasedTasks(registry, systemTime());
+    while (entry != 0x0) {
+        ScheduleEntry *next = entry->next; //Stays walkable even if a task suspends or removes the entry
+        if (entry->state == SCHEDULE_TAKEN) {
+            TCB *task = (TCB *) entry->owner;
+            dispatchTask(task);
+            if (task->thread != 0x0 && PT_RUNNING(task->thread)) {
+                threadRunning = TRUE;
             }
+            requeueTask(registry, entry);
         }
+        entry = next;
+    }
+    return threadRunning;
+}
 
-        //powerGeneration
-        if (*data->solarPanelState) {
-            if (*data->batteryLevel > 95) {
-                *data->solarPanelState = FALSE;
-                *data->powerGeneration = 0;
-            } else if (*data->batteryLevel < 50) {
-                //Increment the variable by 2 every even numbered time
-                if (executionCount % 2 == 0) {
-                    (*data->powerGeneration) += 2;
-                } else { //Increment the variable by 1 every odd numbered time
-                    (*data->powerGeneration) += 1;
-                }
-            } else {
-                //Increment the variable by 2 every even numbered time
-                if (executionCount % 2 == 0) {
-                    (*data->powerGeneration) += 2;
-                }
-            }
-        } else {
-            if (*data->batteryLevel <= 10) {
-                *data->solarPanelState = TRUE;
-            }
+//Returns when the scheduler next has work, the earliest release of a task it runs, nextSummaryTime or nextCheckpointTime
+//Tasks that run on every pass are polled every idlePollInterval, and a protothread with work left makes it now
+unsigned long nextWakeTime(unsigned long nextSummaryTime, unsigned long nextCheckpointTime, Bool threadRunning) {
+    unsigned long now = systemTime();
+    if (threadRunning) {
+        return now;
+    }
+    unsigned long wakeTime = statsSummaryInterval > 0 ? nextSummaryTime : now + idlePollInterval;
+    if (checkpointInterval > 0 && timeBefore(nextCheckpointTime, wakeTime)) {
+        wakeTime = nextCheckpointTime;
+    }
+    unsigned long releaseTime;
+    if (earliestRelease(&SchedulerTasks, &releaseTime) && timeBefore(releaseTime, wakeTime)) {
+        wakeTime = releaseTime;
+    }
+    if (SchedulerTasks.polledCount > 0 && timeBefore(now + idlePollInterval, wakeTime)) {
+        wakeTime = now + idlePollInterval;
+    }
+    return timeBefore(wakeTime, now) ? now : wakeTime;
+}
+
+//Sleeps until wakeTime or until an uplink byte arrives and records the time slept
+//Idle mode keeps Timer0, Timer1 and the UART running, so millis() stays right and any of their interrupts wakes
+//the processor to check again. The millis() interrupt alone wakes it every 1ms
+void idleUntil(unsigned long wakeTime) {
+    if (timeReached(systemTime(), wakeTime) || Serial.available() > 0) {
+        return;
+    }
+    TRACE(TRACE_IDLE_BEGIN, 0);
+    unsigned long start = micros();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while (!timeReached(systemTime(), wakeTime) && Serial.available() == 0) {
+        noInterrupts();
+        sleep_enable();
+        //The instruction after enabling interrupts always runs, so no interrupt can slip in before the sleep
+        interrupts();
+        sleep_cpu();
+        sleep_disable();
+    }
+    recordIdle(&SchedulerIdle, micros() - start);
+    TRACE(TRACE_IDLE_END, 0);
+}
+
+#ifdef USE_TRACE
+//Records a trace event at the current time, safe to call from the kernel tick
+void trace(unsigned char type, unsigned char arg) {
+    noInterrupts();
+    recordTrace(&Trace, micros(), type, arg);
+    interrupts();
+}
+
+//Sends the trace buffer in FRAME_TRACE frames and starts a new window
+//Nothing is recorded while the buffer is full, so it can be read without holding off the kernel tick
+void sendTrace() {
+    unsigned char payload[FRAME_MAX_PAYLOAD / TRACE_EVENT_SIZE * TRACE_EVENT_SIZE];
+    unsigned int perFrame = FRAME_MAX_PAYLOAD / TRACE_EVENT_SIZE;
+    for (unsigned int first = 0; first < Trace.count; first += perFrame) {
+        unsigned int count = min(perFrame, Trace.count - first);
+        packTraceEvents(&Trace.events[first], count, payload);
+        sendFrame(FRAME_TRACE, payload, (unsigned char) (count * TRACE_EVENT_SIZE));
+    }
+    noInterrupts();
+    clearTrace(&Trace);
+    interrupts();
+}
+#endif
+
+//Prints the idle statistics since the last call and starts a new window
+//ie "idle n=2400 slept=59.412 duty=1.0%"
+void printIdleStats() {
+    char number[FORMAT_BUFFER_SIZE];
+    unsigned long now = micros();
+    Serial.print(flashString(STR_IDLE));
+    Serial.print(flashString(STR_STATS_DISPATCHES));
+    formatUnsigned(number, SchedulerIdle.sleeps, 1);
+    Serial.print(number);
+    Serial.print(flashString(STR_IDLE_SLEPT));
+    formatFixedPoint(number, SchedulerIdle.idleMicros / 1000, 3);
+    Serial.print(number);
+    Serial.print(flashString(STR_IDLE_DUTY));
+    formatFixedPoint(number, dutyCyclePermille(&SchedulerIdle, now), 1);
+    Serial.print(number);
+    Serial.println('%');
+    resetIdleStats(&SchedulerIdle, now);
+}
+
+//Fills in a task control block, the first release is immediate
+void initTask(TCB *task, StringId name, void (*function)(void *), void *taskData, unsigned char priority,
+              unsigned long period) {
+    task->task = function;
+    task->taskDataPtr = taskData;
+    task->name = name;
+    task->priority = priority;
+    task->period = period;
+    task->entry.releaseTime = systemTime();
+    task->entry.polled = period == 0 ? TRUE : FALSE;
+    task->lastRunTime = task->entry.releaseTime; //The first run reports its delay from here
+    task->thread = 0x0;
+#ifdef MEASURE_STACK_DEPTH
+    task->stackHighWaterMark = 0;
+#endif
+    resetTaskStats(task);
+}
+
+//Runs a task taken from its registry and records how late it started against its release
+//A protothread that yielded carries on with its release on the next pass, the release is accounted on its first slice
+//Its release only moves on once it finishes, so until then the registry hands it back on every pass
+void dispatchTask(TCB *task) {
+    unsigned long startTime = systemTime();
+    Bool continuing = (task->thread != 0x0 && PT_RUNNING(task->thread)) ? TRUE : FALSE;
+    unsigned long lateness = startTime - task->entry.releaseTime;
+    if (!continuing) {
+        if (task->period > 0) {
+            printTaskTiming(task->name, startTime - task->lastRunTime);
         }
-        //batteryLevel
-        if (*data->solarPanelState) { //If deployed
-            short result = *data->batteryLevel - (*(data->powerConsumption)) + (*(data->powerGeneration));
-            if (result < 0) {
-                *data->batteryLevel = 0;
-            } else {
-                *data->batteryLevel = min((unsigned short) result, 100);
-            }
-        } else { //If not deplyed
-            int result = *data->batteryLevel - 3 * (*(data->powerConsumption));
-            if (result < 0) {
-                *data->batteryLevel = 0;
-            } else {
-                *data->batteryLevel = (unsigned short) result;
+        task->lastRunTime = startTime;
+    }
+
+#ifdef MEASURE_STACK_DEPTH
+    paintStack();
+    char *stackBase = (char *) SP;
+#endif
+
+    TRACE(TRACE_TASK_BEGIN, task->slot);
+    task->task(task->taskDataPtr);
+    TRACE(TRACE_TASK_END, task->slot);
+
+#ifdef MEASURE_STACK_DEPTH
+    unsigned int depth = (unsigned int) (stackBase - lowestStackUse());
+    if (depth > task->stackHighWaterMark) {
+        task->stackHighWaterMark = depth;
+    }
+#endif
+
+    TaskStats *stats = &task->stats;
+    if (!continuing) {
+        stats->dispatches++;
+        if (task->slot < METRIC_TASK_SLOTS) {
+            addMetric(&SystemMetrics, (MetricId) (METRIC_TASK_RUNS + task->slot), 1);
+        }
+        if (lateness > stats->maxLateness) {
+            stats->maxLateness = lateness;
+        }
+        unsigned char bucket = 0;
+        while (bucket < LATENESS_BUCKETS - 1 && lateness >= (1UL << bucket)) {
+            bucket++;
+        }
+        stats->latenessHistogram[bucket]++;
+    }
+
+    if (task->thread != 0x0 && PT_RUNNING(task->thread)) { //The release stays in the past until the last slice
+        return;
+    }
+    unsigned long finishTime = systemTime();
+    if (task->period > 0) {
+        //Releases stay on the original cadence so lateness does not hide as drift
+        task->entry.releaseTime += task->period;
+        if (timeReached(finishTime, task->entry.releaseTime)) { //Overran into the next release, skip the missed ones
+            stats->deadlineMisses++;
+            noInterrupts(); //Tasks of the loop and of the kernel tick both count misses here
+            addMetric(&SystemMetrics, METRIC_DEADLINE_MISSES, 1);
+            interrupts();
+            task->entry.releaseTime += ((finishTime - task->entry.releaseTime) / task->period + 1) * task->period;
+        }
+    } else {
+        //Every pass tasks are due again right away, their lateness is the gap until the next pass reaches them
+        task->entry.releaseTime = finishTime;
+    }
+}
+
+//Copies the dispatch statistics of a task into stats
+void getTaskStats(TCB *task, TaskStats *stats) {
+    noInterrupts(); //The kernel tick may be updating them
+    *stats = task->stats;
+    interrupts();
+}
+
+//Clears the dispatch statistics of a task
+void resetTaskStats(TCB *task) {
+    noInterrupts();
+    memset(&task->stats, 0, sizeof(TaskStats));
+    interrupts();
+}
+
+//Prints one compact line of dispatch statistics per task
+//ie "stats powerSubsystemTask n=12 miss=0 max=3 h=9/2/1/0/0/0/0/0"
+void printTaskStats() {
+    printRegistryStats(&SchedulerTasks);
+#ifdef USE_PREEMPTIVE_KERNEL
+    for (unsigned char level = TASK_PRIORITY_ALARM; level > TASK_PRIORITY_BACKGROUND; level--) {
+        printRegistryStats(&KernelTasks[level - 1]);
+    }
+#endif
+#ifdef MEASURE_STACK_DEPTH
+    char number[FORMAT_BUFFER_SIZE];
+    Serial.print(flashString(STR_STATS_STACK_FREE));
+    formatUnsigned(number, (unsigned int) (lowestStackUse() - stackLimit()), 1);
+    Serial.println(number);
+#endif
+}
+
+//Prints the dispatch statistics line of every task in registry, suspended ones included
+void printRegistryStats(TaskRegistry *registry) {
+    char number[FORMAT_BUFFER_SIZE];
+    TaskStats stats;
+    for (unsigned int i = 0; i < registry->count; i++) {
+        TCB *task = (TCB *) registry->entries[i]->owner;
+        getTaskStats(task, &stats);
+        Serial.print(flashString(STR_STATS));
+        Serial.print(flashString(task->name));
+        Serial.print(flashString(STR_STATS_DISPATCHES));
+        formatUnsigned(number, stats.dispatches, 1);
+        Serial.print(number);
+        Serial.print(flashString(STR_STATS_MISSES));
+        formatUnsigned(number, stats.deadlineMisses, 1);
+        Serial.print(number);
+        Serial.print(flashString(STR_STATS_MAX_LATENESS));
+        formatUnsigned(number, stats.maxLateness, 1);
+        Serial.print(number);
+        Serial.print(flashString(STR_STATS_HISTOGRAM));
+        for (unsigned int bucket = 0; bucket < LATENESS_BUCKETS; bucket++) {
+            if (bucket > 0) {
+                Serial.print('/');
             }
+            formatUnsigned(number, stats.latenessHistogram[bucket], 1);
+            Serial.print(number);
         }
-        nextExecutionTime = systemTime() + runDelay;
-        executionCount++;
+#ifdef MEASURE_STACK_DEPTH
+        Serial.print(flashString(STR_STATS_STACK));
+        formatUnsigned(number, task->stackHighWaterMark, 1);
+        Serial.print(number);
+#endif
+        Serial.println();
     }
 }
 
-//Controls the execution of the thruster subsystem
-void thrusterSubsystemTask(void *thrusterSubsystemData) {
-    static unsigned long nextExecutionTime = 0;
-    static unsigned long lastExecutionTime = 0;
-    if (nextExecutionTime == 0 || nextExecutionTime < systemTime()) {
-        printTaskTiming("thrusterSubsystemTask", lastExecutionTime);
-        lastExecutionTime = systemTime();
-        ThrusterSubsystemData *data = (ThrusterSubsystemData *) thrusterSubsystemData;
-        unsigned short left = 0, right = 0, up = 0, down = 0;
-
-        unsigned int signal = *(data->thrusterControl);
-
-        unsigned int direction = signal & (0xF); // Get the last 4 bits
-        unsigned int magnitude = (signal & (0xF0)) >> 4; // Get the 5-7th bit and shift if back down
-        unsigned int duration = (signal & (0xFF00)) >> 8;
-
-        //Debug print info
-        //printf("\t\tDirection %d\n", direction);
-        //printf("\t\tMagnitude %d\n", magnitude);
-        //printf("\t\tDuration %d\n", duration);
-
-        //printf("thrusterSubsystemTask\n");
-
-        //Adjust fuel level based on command
-        if (*data->fuelLevel > 0 && (int) *data->fuelLevel >= ((int) *data->fuelLevel - 4 * duration / 100)) {
-            *data->fuelLevel = max(0, *data->fuelLevel -
-                                      4 * duration / 100); //magnitude at this point is full on and full off
-        } else {
-            *data->fuelLevel = 0;
+#ifdef MEASURE_STACK_DEPTH
+//Byte written over the free stack, anything else found there was written by a stack frame
+#define STACK_PAINT 0xC5
+
+//Provided by avr-libc, the heap starts at __heap_start and currently ends at __brkval
+extern char __heap_start;
+extern char *__brkval;
+
+//Returns the lowest address the stack can grow down to
+char *stackLimit() {
+    return __brkval != 0x0 ? __brkval : &__heap_start;
+}
+
+//Fills the free stack below the caller with STACK_PAINT
+void paintStack() {
+    noInterrupts(); //An interrupt frame pushed mid paint would be overwritten
+    char *top = (char *) SP;
+    for (char *p = stackLimit(); p < top; p++) {
+        *p = STACK_PAINT;
+    }
+    interrupts();
+}
+
+//Returns the lowest stack address that no longer holds STACK_PAINT
+char *lowestStackUse() {
+    char *p = stackLimit();
+    while (p < (char *) SP && *p == STACK_PAINT) {
+        p++;
+    }
+    return p;
+}
+#endif
+
+#ifdef USE_PREEMPTIVE_KERNEL
+//Priority of the code currently running, the task loop runs at TASK_PRIORITY_BACKGROUND
+volatile unsigned char runningPriority = TASK_PRIORITY_BACKGROUND;
+
+//Starts the 1ms timer tick that runs the tasks above TASK_PRIORITY_BACKGROUND
+void startKernelTick() {
+    noInterrupts();
+    //Timer1 in CTC mode, 16MHz / 64 / 250 = 1kHz. Timer0 stays with millis()
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+    TCNT1 = 0;
+    OCR1A = 249;
+    TIMSK1 |= _BV(OCIE1A);
+    interrupts();
+}
+
+//Runs every task whose priority is above the priority of the code the tick interrupted, highest first
+//Tasks run to completion on top of whatever they preempted, so no task needs a stack of its own. The alarm task
+//shares the tft with the dashboard drawing from the task loop, and lockDisplay keeps it off the tft meanwhile, so
+//an alarm starts within one tick plus the longest lockDisplay section, the first updateGauge of a gauge drawing its
+//caption through the GFX text routines
+void kernelTick() {
+    //Drain the serial port every tick so its small buffer cannot overflow while a task blocks
+    //Only one tick at a time may feed the ring, it has a single producer
+    static volatile Bool receiving = FALSE;
+    noInterrupts();
+    if (!receiving) {
+        receiving = TRUE;
+        interrupts();
+        receiveUplink(&UplinkRing);
+        noInterrupts();
+        receiving = FALSE;
+    }
+    interrupts();
+
+    for (unsigned char level = TASK_PRIORITY_ALARM; level > TASK_PRIORITY_BACKGROUND; level--) {
+        noInterrupts();
+        unsigned char preempted = runningPriority;
+        if (level <= preempted) { //Already running at this level or above, a later tick will get it
+            interrupts();
+            return;
         }
+        runningPriority = level;
+        interrupts();
 
+        runReleasedTasks(&KernelTasks[level - 1]);
+
+        noInterrupts();
+        runningPriority = preempted;
+        interrupts();
+    }
+}
+
+//Interrupts stay enabled while the tick runs tasks so millis() and the serial transmitter keep going
+ISR(TIMER1_COMPA_vect, ISR_NOBLOCK) {
+    kernelTick();
+}
+#endif
 
-        nextExecutionTime = systemTime() + runDelay;
+//Controls the execution of the power subsystem
+void powerSubsystemTask(void *powerSubsystemData) {
+    PowerSubsystemData *data = (PowerSubsystemData *) powerSubsystemData;
+    Bool wasDeployed = *data->solarPanelState;
+    stepPowerModel(data->model, data->solarPanelState, data->batteryLevel, data->powerConsumption,
+                   data->powerGeneration);
+    if (*data->solarPanelState != wasDeployed) {
+        addMetric(&SystemMetrics, METRIC_SOLAR_TOGGLES, 1);
     }
+    unsigned long now = systemTime();
+    recordSample(data->batteryHistory, *data->batteryLevel, now);
+    recordSample(data->consumptionHistory, *data->powerConsumption, now);
+    recordSample(data->generationHistory, *data->powerGeneration, now);
+}
 
+//Controls the execution of the thruster subsystem
+void thrusterSubsystemTask(void *thrusterSubsystemData) {
+    ThrusterSubsystemData *data = (ThrusterSubsystemData *) thrusterSubsystemData;
+    stepThrusterModel(*data->thrusterControl, data->fuelLevel);
+    recordSample(data->fuelHistory, *data->fuelLevel, systemTime());
 }
 
 //Generates a random signal for the thruster based on the assignment specs
 //Choose a random direction, magnitude, and duration and shifts the bits to fit that information into 16 bits
 unsigned int getRandomThrustSignal() {
-    unsigned int signal = 1;
-    unsigned short direction = (unsigned short) randomInteger(0, 4);
-    if (direction == 4) //No thrust
-        return 0;
-    signal = signal << direction;
-    unsigned int magnitude = randomInteger(0, 15);
-    unsigned int duration = randomInteger(0, 255);
-
-    signal = signal | (magnitude << 4);
-    signal = signal | (duration << 8);
-    return signal;
+    return randomThrustSignal(&randomGenerationSeed);
 }
 
 //Controls the execution of the satellite coms subsystem
 void satelliteComsTask(void *satelliteComsData) {
-    static unsigned long nextExecutionTime = 0;
-    static unsigned long lastExecutionTime = 0;
-    if (nextExecutionTime == 0 || nextExecutionTime < systemTime()) {
-        printTaskTiming("satelliteComsTask", lastExecutionTime);
-        lastExecutionTime = systemTime();
-        SatelliteComsData *data = (SatelliteComsData *) satelliteComsData;
-        //printf("satelliteComsTask\n");
-        //TODO: In future labs, send the following data:
-        /*
-            * Fuel Low
-            * Battery Low
-            * Solar Panel State
-            * Battery Level
-            * Fuel Level
-            * Power Consumption
-            * Power Generation
-         */
+    SatelliteComsData *data = (SatelliteComsData *) satelliteComsData;
+    static unsigned short batch[TELEMETRY_BATCH_SAMPLES][TELEMETRY_CHANNELS];
+    static int batchCount = 0;
+    //printf("satelliteComsTask\n");
+    //TODO: In future labs, send the following data:
+    /*
+        * Fuel Low
+        * Battery Low
+        * Solar Panel State
+     */
+    if (shouldSendTelemetry) {
+        //Batched so consecutive samples can be delta encoded, the levels only move a little per period
+        unsigned short *sample = batch[batchCount];
+        sample[TELEMETRY_BATTERY_LEVEL] = latestSample(data->batteryHistory, *data->batteryLevel);
+        sample[TELEMETRY_FUEL_LEVEL] = latestSample(data->fuelHistory, *data->fuelLevel);
+        sample[TELEMETRY_POWER_CONSUMPTION] = latestSample(data->consumptionHistory, *data->powerConsumption);
+        sample[TELEMETRY_POWER_GENERATION] = latestSample(data->generationHistory, *data->powerGeneration);
+        batchCount++;
+        if (batchCount == TELEMETRY_BATCH_SAMPLES) {
+            sendTelemetryBatch(batch, batchCount);
+            batchCount = 0;
+        }
+    }
 
+    if (*data->thrustCommandPending) { //A ground command replaces the generated signal for this period
+        *data->thrustCommandPending = FALSE;
+    } else {
         *(data->thrusterControl) = getRandomThrustSignal();
-        nextExecutionTime = systemTime() + runDelay;
     }
 }
 
 //Controls the execution of the console display subsystem
+//Runs as a protothread that yields after every line, so one period's output is spread over several scheduler passes
+//The lines show the values trackChanges recorded when the period started, so they match what it compares against next
 void consoleDisplayTask(void *consoleDisplayData) {
-    static unsigned long nextExecutionTime = 0;
-    static unsigned long lastExecutionTime = 0;
-    if (nextExecutionTime == 0 || nextExecutionTime < systemTime()) {
-        printTaskTiming("consoleDisplayTask", lastExecutionTime);
-        lastExecutionTime = systemTime();
-        ConsoleDisplayData *data = (ConsoleDisplayData *) consoleDisplayData;
-        Bool inStatusMode = TRUE; //TODO get this from some external input
-        //printf("consoleDisplayTask\n");
-        if (inStatusMode) {
-            //Print
-            //Solar Panel State
-            //Battery Level
-            //Fuel Level
-            //Power Consumption
-            Serial.print("\tSolar Panel State: ");
-            Serial.println((*data->solarPanelState ? " ON" : "OFF"));
-            Serial.print("\tBattery Level: ");
-            Serial.println(*data->batteryLevel);
-            Serial.print("\tFuel Level: ");
-            Serial.println(*data->fuelLevel);
-            Serial.print("\tPower Consumption: ");
-            Serial.println(*data->powerConsumption);
-            Serial.print("\tPower Generation: ");
-            Serial.println(*data->powerGeneration);
+    static ChangeTracker tracker;
+    static unsigned char changed;
+    ConsoleDisplayData *data = (ConsoleDisplayData *) consoleDisplayData;
+    char number[FORMAT_BUFFER_SIZE];
+    size_t written; //Bytes of the current line, added to the serial byte count before each yield
+
+    PT_BEGIN(&data->thread);
+    changed = trackChanges(&tracker, consoleKeyframeInterval, *data->solarPanelState,
+                           *data->batteryLevel, *data->fuelLevel, *data->powerConsumption,
+                           *data->powerGeneration, *data->fuelLow, *data->batteryLow);
+    //Keep only what this mode prints, outside status mode a warning only when it is raised
+    if (*data->inStatusMode) {
+        changed &= CHANGED_VALUES;
+    } else {
+        changed &= CHANGED_LOW_FLAGS;
+        if (!tracker.fuelLow) {
+            changed &= ~CHANGED_FUEL_LOW;
+        }
+        if (!tracker.batteryLow) {
+            changed &= ~CHANGED_BATTERY_LOW;
+        }
+    }
+    if (changed == 0) { //Nothing new to show, skip formatting and the serial write entirely
+        PT_EXIT(&data->thread);
+    }
+    if (*data->inStatusMode) {
+        //Print only the fields that moved since the last print
+        //Solar Panel State
+        //Battery Level
+        //Fuel Level
+        //Power Consumption
+        if (changed & CHANGED_SOLAR_PANEL_STATE) {
+            written = Serial.print(flashString(STR_SOLAR_PANEL_STATE));
+            written += Serial.println(flashString(tracker.solarPanelState ? STR_ON : STR_OFF));
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+        if (changed & CHANGED_BATTERY_LEVEL) {
+            written = Serial.print(flashString(STR_BATTERY_LEVEL));
+            formatUnsigned(number, tracker.batteryLevel, 1);
+            written += Serial.println(number);
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+        if (changed & CHANGED_FUEL_LEVEL) {
+            written = Serial.print(flashString(STR_FUEL_LEVEL));
+            formatUnsigned(number, tracker.fuelLevel, 1);
+            written += Serial.println(number);
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+        if (changed & CHANGED_POWER_CONSUMPTION) {
+            written = Serial.print(flashString(STR_POWER_CONSUMPTION));
+            formatUnsigned(number, tracker.powerConsumption, 1);
+            written += Serial.println(number);
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+        if (changed & CHANGED_POWER_GENERATION) {
+            written = Serial.print(flashString(STR_POWER_GENERATION));
+            formatUnsigned(number, tracker.powerGeneration, 1);
+            written += Serial.println(number);
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+    } else {
+        if (changed & CHANGED_FUEL_LOW) {
+            written = Serial.println(flashString(STR_FUEL_LOW));
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+        if (changed & CHANGED_BATTERY_LOW) {
+            written = Serial.println(flashString(STR_BATTERY_LOW));
+            addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, written);
+            PT_YIELD(&data->thread);
+        }
+    }
+    //Only reached after at least one line, so the separator never goes out on its own
+    addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, Serial.println());
+    PT_END(&data->thread);
+}
 
-        } else {
-            if (*data->fuelLow == TRUE) {
-                Serial.println("Fuel Low!");
-            }
-            if (*data->batteryLow == TRUE) {
-                Serial.println("Battery Low!");
-            }
+//Controls the execution of the tft dashboard, redraws at most one gauge per call
+void dashboardDisplayTask(void *dashboardDisplayData) {
+    DashboardDisplayData *data = (DashboardDisplayData *) dashboardDisplayData;
+    static GaugeState gauges[DASHBOARD_GAUGES];
+    static unsigned int nextGauge = 0;
+
+    unsigned short value;
+    switch (nextGauge) {
+        case 0:
+            value = *data->batteryLevel;
+            break;
+        case 1:
+            value = *data->fuelLevel;
+            break;
+        case 2:
+            value = *data->powerConsumption;
+            break;
+        default:
+            value = *data->powerGeneration;
+            break;
+    }
+    updateGauge(nextGauge, &gauges[nextGauge], value);
+    nextGauge = (nextGauge + 1) % DASHBOARD_GAUGES;
+}
+
+//Brings one gauge on the tft up to date with value, drawing only the part of the bar that changed
+void updateGauge(unsigned int index, GaugeState *gauge, unsigned short value) {
+    if (gauge->drawn && gauge->shownValue == value) { //Nothing to draw, the common case
+        return;
+    }
+    addMetric(&SystemMetrics, METRIC_GAUGE_DRAWS, 1);
+    GaugeLayout layout;
+    memcpy_P(&layout, &gaugeLayouts[index], sizeof(GaugeLayout));
+    TRACE(TRACE_LCD_DRAW, layout.caption);
+    int top = DASHBOARD_TOP + index * GAUGE_ROW_HEIGHT;
+    int barTop = top + GAUGE_BAR_OFFSET;
+    unsigned char previousPriority = lockDisplay();
+
+    if (!gauge->drawn) {
+        //Caption and frame never change, draw them once
+        const char *caption = (const char *) pgm_read_ptr(&stringTable[layout.caption]);
+        tft.setTextSize(1);
+        tft.setTextColor(WHITE);
+        tft.setCursor(0, top);
+        for (int i = 0; pgm_read_byte(&caption[i]) != '\0'; i++) {
+            tft.print((char) pgm_read_byte(&caption[i]));
         }
-        Serial.println();
-        nextExecutionTime = systemTime() + runDelay;
+        tft.drawRect(0, barTop, GAUGE_BAR_WIDTH, GAUGE_BAR_HEIGHT, WHITE);
+        gauge->filledWidth = 0;
+        gauge->drawn = TRUE;
+    }
+
+    //Only the columns between the old and the new end of the bar change
+    int innerWidth = GAUGE_BAR_WIDTH - 2;
+    int filledWidth = (int) ((unsigned long) min(value, layout.fullScale) * innerWidth / layout.fullScale);
+    if (filledWidth > gauge->filledWidth) {
+        fillArea(1 + gauge->filledWidth, barTop + 1, filledWidth - gauge->filledWidth, GAUGE_BAR_HEIGHT - 2,
+                 layout.color);
+    } else if (filledWidth < gauge->filledWidth) {
+        fillArea(1 + filledWidth, barTop + 1, gauge->filledWidth - filledWidth, GAUGE_BAR_HEIGHT - 2, NONE);
     }
+    gauge->filledWidth = filledWidth;
+
+    //Fixed width readout with a background color overwrites the old digits without clearing first
+    char number[FORMAT_BUFFER_SIZE];
+    formatUnsigned(number, min(value, 999), 3);
+    drawText(number, GAUGE_READOUT_X, barTop, WHITE, NONE);
+    gauge->shownValue = value;
+
+    unlockDisplay(previousPriority);
+}
+
+//Keeps the preemptive kernel from running tft tasks until unlockDisplay, returns what to pass to unlockDisplay
+//The alarm task is the highest priority task using the tft, so raising to its priority is enough
+//The alarm waits out the whole section, so keep every locked section as short as updateGauge's
+unsigned char lockDisplay() {
+#ifdef USE_PREEMPTIVE_KERNEL
+    noInterrupts();
+    unsigned char previousPriority = runningPriority;
+    if (runningPriority < TASK_PRIORITY_ALARM) {
+        runningPriority = TASK_PRIORITY_ALARM;
+    }
+    interrupts();
+    return previousPriority;
+#else
+    return TASK_PRIORITY_BACKGROUND;
+#endif
+}
+
+//Lets tasks preempted by lockDisplay run again
+void unlockDisplay(unsigned char previousPriority) {
+#ifdef USE_PREEMPTIVE_KERNEL
+    noInterrupts();
+    runningPriority = previousPriority;
+    interrupts();
+#endif
 }
 
 //Controls the execution of the warning alarm subsystem
@@ -527,70 +1693,51 @@ void warningAlarmTask(void *warningAlarmData) {
     //printf("warningAlarmTask\n");
     static int fuelStatus = NONE;
     static int batteryStatus = NONE;
-    static unsigned long hideFuelTime = 0;
-    static unsigned long showFuelTime = 0;
-    static unsigned long hideBatteryTime = 0;
-    static unsigned long showBatteryTime = 0;
-
-    *data->fuelLow = *data->fuelLevel <= 10 ? TRUE : FALSE;
-    *data->batteryLow = *data->batteryLow <= 10 ? TRUE : FALSE;
+    //Whether each status is blinked off, and when it next blinks. No time is special, so the blink survives the wrap
+    static Bool fuelHidden = FALSE;
+    static unsigned long fuelBlinkTime = 0;
+    static Bool batteryHidden = FALSE;
+    static unsigned long batteryBlinkTime = 0;
 
-    int fuelDelay = (*data->fuelLevel <= 10) ? 2000 : 1000;
-    int fuelColor = (*data->fuelLevel <= 10) ? RED : ORANGE;
+    //Reading the colors also brings FuelLow and BatteryLow up to date
+    int fuelDelay = readSignal(data->fuelDelay);
+    int fuelColor = readSignal(data->fuelColor);
 
-    if (*data->fuelLevel <= 50) {
+    if (fuelColor != GREEN) {
         if (fuelStatus == fuelColor) {
-            if (showFuelTime == 0) { //If showing fuel status
-                if (hideFuelTime < systemTime()) {
-                    showFuelTime = systemTime() + fuelDelay;
-                    hideFuelTime = 0;
-                    //TODO hide fuel status with color fuelColor
-                    print("FUEL", 4, NONE, 0);
-                }
-            } else { //If hiding fuel status
-                if (showFuelTime < systemTime()) {
-                    hideFuelTime = systemTime() + fuelDelay;
-                    showFuelTime = 0;
-                    //TODO show fuel status with fuelColor
-                    print("FUEL", 4, fuelColor, 0);
-                }
+            if (timeBefore(fuelBlinkTime, systemTime())) { //Hides a shown status and shows a hidden one
+                fuelBlinkTime = systemTime() + fuelDelay;
+                fuelHidden = fuelHidden ? FALSE : TRUE;
+                print(STR_FUEL, fuelHidden ? NONE : fuelColor, 0);
             }
         } else {
             fuelStatus = fuelColor;
-            print("FUEL", 4, fuelColor, 0);
-            hideFuelTime = systemTime() + fuelDelay;
+            print(STR_FUEL, fuelColor, 0);
+            fuelHidden = FALSE;
+            fuelBlinkTime = systemTime() + fuelDelay;
         }
     } else if (fuelStatus != GREEN) {
-        print("FUEL", 4, GREEN, 0);
+        print(STR_FUEL, GREEN, 0);
         fuelStatus = GREEN;
     }
 
-    int batteryDelay = (*data->batteryLevel <= 10) ? 1000 : 2000;
-    int batteryColor = (*data->batteryLevel <= 10) ? RED : ORANGE;
-    if (*data->batteryLevel <= 50) {
+    int batteryDelay = readSignal(data->batteryDelay);
+    int batteryColor = readSignal(data->batteryColor);
+    if (batteryColor != GREEN) {
         if (batteryStatus == batteryColor) {
-            if (showBatteryTime == 0) { //If showing battery status
-                if (hideBatteryTime < systemTime()) {
-                    showBatteryTime = systemTime() + batteryDelay;
-                    hideBatteryTime = 0;
-                    //TODO hide battery status with color batteryColor
-                    print("BATTERY", 7, NONE, 1);
-                }
-            } else { //If hiding battery status
-                if (showBatteryTime < systemTime()) {
-                    hideBatteryTime = systemTime() + batteryDelay;
-                    showBatteryTime = 0;
-                    //TODO show battery status
-                    print("BATTERY", 7, batteryColor, 1);
-                }
+            if (timeBefore(batteryBlinkTime, systemTime())) { //Hides a shown status and shows a hidden one
+                batteryBlinkTime = systemTime() + batteryDelay;
+                batteryHidden = batteryHidden ? FALSE : TRUE;
+                print(STR_BATTERY, batteryHidden ? NONE : batteryColor, 1);
             }
         } else {
             batteryStatus = batteryColor;
-            print("BATTERY", 7, batteryColor, 1);
-            hideBatteryTime = systemTime() + batteryDelay;
+            print(STR_BATTERY, batteryColor, 1);
+            batteryHidden = FALSE;
+            batteryBlinkTime = systemTime() + batteryDelay;
         }
     } else if (batteryStatus != GREEN) {
-        print("BATTERY", 7, GREEN, 1);
+        print(STR_BATTERY, GREEN, 1);
         batteryStatus = GREEN;
     }
 }
@@ -598,55 +1745,402 @@ void warningAlarmTask(void *warningAlarmData) {
 //Returns a random integer between low and high inclusively
 //Code taken from class website: https://class.ece.uw.edu/474/peckol/assignments/lab2/rand1.c
 int randomInteger(int low, int high) {
-    double randNum = 0.0;
-    int multiplier = 2743;
-    int addOn = 5923;
-    double max = INT_MAX + 1.0;
-
-    int retVal = 0;
-
-    if (low > high)
-        retVal = randomInteger(high, low);
-    else {
-        randomGenerationSeed = randomGenerationSeed * multiplier + addOn;
-        randNum = randomGenerationSeed;
+    return randomIntegerFrom(&randomGenerationSeed, low, high);
+}
 
-        if (randNum < 0) {
-            randNum = randNum + max;
+//Prints a string table entry to the tft given the string, a color, and a line number
+//The label bitmap is streamed through a single address window, printing with NONE hides it
+void print(StringId str, int color, int line) {
+    TRACE(TRACE_LCD_DRAW, str);
+    LabelBitmap *bitmap = cachedLabel(str);
+    addMetric(&SystemMetrics, METRIC_LABEL_DRAWS, 1);
+    addMetric(&SystemMetrics, METRIC_GLYPH_WRITES, bitmap->width / GLYPH_WIDTH);
+    int width = bitmap->width * LABEL_SCALE;
+    int height = GLYPH_HEIGHT * LABEL_SCALE;
+    int top = line * height;
+    if (LcdBusReady) { //Each row goes out as runs, mostly strobes with the data lines left alone
+        lcdStartWindow(0, top, width - 1, top + height - 1);
+        for (int y = 0; y < height; y++) {
+            lcdPushBitmapRow(bitmap->rows[y / LABEL_SCALE], bitmap->width, LABEL_SCALE, color, NONE);
+        }
+        lcdEndWindow();
+        return;
+    }
+    tft.setAddrWindow(0, top, width - 1, top + height - 1);
+
+    uint16_t pixels[16];
+    uint8_t count = 0;
+    boolean first = true;
+    for (int y = 0; y < height; y++) {
+        unsigned char *row = bitmap->rows[y / LABEL_SCALE];
+        for (int x = 0; x < width; x++) {
+            int column = x / LABEL_SCALE;
+            pixels[count++] = (row[column / 8] & (0x80 >> (column % 8))) ? color : NONE;
+            if (count == sizeof(pixels) / sizeof(pixels[0])) {
+                tft.pushColors(pixels, count, first);
+                first = false;
+                count = 0;
+            }
         }
+    }
+    if (count > 0) {
+        tft.pushColors(pixels, count, first);
+    }
+    //Library drawing expects the window to cover the whole screen again
+    tft.setAddrWindow(0, 0, tft.width() - 1, tft.height() - 1);
+}
 
-        randNum = randNum / max;
+//Returns the cached bitmap of a label, rasterizing it on first use
+LabelBitmap *cachedLabel(StringId label) {
+    LabelBitmap *bitmap = &labelCache[label];
+    if (bitmap->rasterized) {
+        return bitmap;
+    }
+    memset(bitmap, 0, sizeof(LabelBitmap));
+    const char *text = (const char *) pgm_read_ptr(&stringTable[label]);
+    for (int i = 0; i < LABEL_MAX_CHARS && pgm_read_byte(&text[i]) != '\0'; i++) {
+        rasterizeGlyph((char) pgm_read_byte(&text[i]), i, &bitmap->rows[0][0], LABEL_ROW_BYTES);
+        bitmap->width += GLYPH_WIDTH;
+    }
+    bitmap->rasterized = TRUE;
+    return bitmap;
+}
 
-        retVal = ((int) ((high - low + 1) * randNum)) + low;
+//Sets the bits of character c's glyph in the cell at index of rows, a 1 bit per pixel bitmap rowBytes wide
+//Characters without a glyph are left blank
+void rasterizeGlyph(char c, int index, unsigned char *rows, int rowBytes) {
+    for (unsigned int glyph = 0; glyph < sizeof(labelGlyphs) / sizeof(labelGlyphs[0]); glyph++) {
+        if (pgm_read_byte(&labelGlyphs[glyph][0]) != c) {
+            continue;
+        }
+        for (int column = 0; column < GLYPH_WIDTH - 1; column++) { //The last column is spacing
+            unsigned char bits = pgm_read_byte(&labelGlyphs[glyph][column + 1]);
+            int x = index * GLYPH_WIDTH + column;
+            for (int y = 0; y < GLYPH_HEIGHT; y++) {
+                if (bits & (1 << y)) {
+                    rows[y * rowBytes + x / 8] |= 0x80 >> (x % 8);
+                }
+            }
+        }
+        return;
     }
+}
 
-    return retVal;
+//Draws text at LABEL_SCALE with its top left corner at x, y, over a background color
+//With lcdbus the whole text is one address window, the library would open one per font pixel
+//Only the characters in labelGlyphs are drawn, and at most LABEL_MAX_CHARS of them
+void drawText(const char *text, int x, int y, int color, int background) {
+    if (!LcdBusReady) {
+        tft.setTextSize(LABEL_SCALE);
+        tft.setTextColor(color, background);
+        tft.setCursor(x, y);
+        tft.print(text);
+        return;
+    }
+    unsigned char rows[GLYPH_HEIGHT][LABEL_ROW_BYTES];
+    memset(rows, 0, sizeof(rows));
+    int length = 0;
+    while (length < LABEL_MAX_CHARS && text[length] != '\0') {
+        rasterizeGlyph(text[length], length, &rows[0][0], LABEL_ROW_BYTES);
+        length++;
+    }
+    if (length == 0) {
+        return;
+    }
+    addMetric(&SystemMetrics, METRIC_GLYPH_WRITES, length);
+    int width = length * GLYPH_WIDTH;
+    lcdStartWindow(x, y, x + width * LABEL_SCALE - 1, y + GLYPH_HEIGHT * LABEL_SCALE - 1);
+    for (int row = 0; row < GLYPH_HEIGHT * LABEL_SCALE; row++) {
+        lcdPushBitmapRow(rows[row / LABEL_SCALE], width, LABEL_SCALE, color, background);
+    }
+    lcdEndWindow();
 }
 
-//Prints a string to the tft given text, the length of the text, a color, and a line number
-void print(char str[], int length, int color, int line) {
-    //To flash the selected line, you must print exact same string black then recolor
-    for (int i = 0; i < length; i++) {
-        tft.setTextColor(color);
-        tft.setCursor(i * 12, line * 16);
-        tft.print(str[i]);
+//Fills a rectangle of the tft with a color
+void fillArea(int x, int y, int w, int h, int color) {
+    if (LcdBusReady) {
+        lcdFillRect(x, y, w, h, color);
+    } else {
+        tft.fillRect(x, y, w, h, color);
     }
 }
 
-//Starts up the system by creating all the objects that are needed to run the system
-void printTaskTiming(char taskName[], unsigned long lastRunTime) {
+//Returns a string table entry in the form Serial.print expects for flash strings
+const __FlashStringHelper *flashString(StringId id) {
+    return (const __FlashStringHelper *) pgm_read_ptr(&stringTable[id]);
+}
+
+//Prints timing information for a function given the milliseconds since it last ran
+void printTaskTiming(StringId taskName, unsigned long delay) {
     if (shouldPrintTaskTiming) {
-        Serial.print(taskName);
-        Serial.print(" - cycle delay: ");
-        if (lastRunTime > 0) {
-            Serial.println((double) (systemTime() - lastRunTime) / 1000.0, 4);
-        } else {
-            Serial.println(0.0, 4);
-        }
+        Serial.print(flashString(taskName));
+        Serial.print(flashString(STR_CYCLE_DELAY));
+        //Delay is kept in whole milliseconds and printed as seconds, no floating point needed
+        char seconds[FORMAT_BUFFER_SIZE];
+        formatFixedPoint(seconds, delay, 3);
+        Serial.println(seconds);
     }
 }
 
 //Returns the current system time in milliseconds
+//It wraps after about 49.7 days, so compare times with timeReached and timeBefore rather than < and >=
 unsigned long systemTime() {
     return millis();
-}
\ No newline at end of file
+}
+
+//Returns the milliseconds since power on extended to 64 bits, so they never wrap
+//Keeps the wrap count up to date, the scheduler calls it on every pass for that
+uint64_t systemUptime() {
+    noInterrupts(); //The kernel tick may call it too
+    uint64_t uptime = extendTime(&SystemTimeBase, millis());
+    interrupts();
+    return uptime;
+}
+
+//Returns the CHANGED_* flags of the values that differ from the last emitted ones, or CHANGED_ALL when a keyframe is due
+//The given values are recorded as emitted
+unsigned char trackChanges(ChangeTracker *tracker, unsigned int keyframeInterval, Bool solarPanelState,
+                           unsigned short batteryLevel, unsigned short fuelLevel, unsigned short powerConsumption,
+                           unsigned short powerGeneration, Bool fuelLow, Bool batteryLow) {
+    unsigned char changed = 0;
+    if (!tracker->hasEmitted || tracker->periodsSinceKeyframe >= keyframeInterval) {
+        //Keyframe, everything is sent again so a late listener still gets the full state
+        changed = CHANGED_ALL;
+        tracker->periodsSinceKeyframe = 0;
+        tracker->hasEmitted = TRUE;
+    } else {
+        if (tracker->solarPanelState != solarPanelState) changed |= CHANGED_SOLAR_PANEL_STATE;
+        if (tracker->batteryLevel != batteryLevel) changed |= CHANGED_BATTERY_LEVEL;
+        if (tracker->fuelLevel != fuelLevel) changed |= CHANGED_FUEL_LEVEL;
+        if (tracker->powerConsumption != powerConsumption) changed |= CHANGED_POWER_CONSUMPTION;
+        if (tracker->powerGeneration != powerGeneration) changed |= CHANGED_POWER_GENERATION;
+        if (tracker->fuelLow != fuelLow) changed |= CHANGED_FUEL_LOW;
+        if (tracker->batteryLow != batteryLow) changed |= CHANGED_BATTERY_LOW;
+        tracker->periodsSinceKeyframe++;
+    }
+    tracker->solarPanelState = solarPanelState;
+    tracker->batteryLevel = batteryLevel;
+    tracker->fuelLevel = fuelLevel;
+    tracker->powerConsumption = powerConsumption;
+    tracker->powerGeneration = powerGeneration;
+    tracker->fuelLow = fuelLow;
+    tracker->batteryLow = batteryLow;
+    return changed;
+}
+
+//Writes value in decimal into buffer, zero padded to at least width digits, and returns the number of characters written
+//buffer must hold FORMAT_BUFFER_SIZE characters
+int formatUnsigned(char buffer[], unsigned long value, int width) {
+    char digits[FORMAT_BUFFER_SIZE];
+    int count = 0;
+    do { //Collect digits least significant first
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count < width && count < FORMAT_BUFFER_SIZE - 1) {
+        digits[count++] = '0';
+    }
+    for (int i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    buffer[count] = '\0';
+    return count;
+}
+
+//Writes a fixed point value with fractionDigits digits after the decimal point into buffer, ie 1234 with 3 digits is 1.234
+//Returns the number of characters written, buffer must hold FORMAT_BUFFER_SIZE characters
+int formatFixedPoint(char buffer[], unsigned long value, int fractionDigits) {
+    unsigned long scale = 1;
+    for (int i = 0; i < fractionDigits; i++) {
+        scale *= 10;
+    }
+    int length = formatUnsigned(buffer, value / scale, 1);
+    if (fractionDigits > 0) {
+        buffer[length++] = '.';
+        length += formatUnsigned(buffer + length, value % scale, fractionDigits);
+    }
+    return length;
+}
+
+//Starts an accumulator over at time
+void resetAccumulator(Accumulator *accumulator, unsigned long time) {
+    accumulator->min = USHRT_MAX;
+    accumulator->max = 0;
+    accumulator->sum = 0;
+    accumulator->count = 0;
+    accumulator->startTime = time;
+}
+
+//Adds a value to an accumulator
+void accumulate(Accumulator *accumulator, unsigned short min, unsigned short max, unsigned short value) {
+    if (min < accumulator->min) accumulator->min = min;
+    if (max > accumulator->max) accumulator->max = max;
+    accumulator->sum += value;
+    accumulator->count++;
+}
+
+//Returns the summary of everything added to an accumulator
+Aggregate closeAccumulator(Accumulator *accumulator) {
+    Aggregate aggregate;
+    aggregate.min = accumulator->min;
+    aggregate.max = accumulator->max;
+    aggregate.avg = (unsigned short) (accumulator->sum / accumulator->count);
+    return aggregate;
+}
+
+//Adds a sample taken at time to a history, closing minute and hour entries as their time runs out
+void recordSample(History *history, unsigned short value, unsigned long time) {
+    if (history->rawCount == 0) { //First sample
+        resetAccumulator(&history->minute, time);
+        resetAccumulator(&history->hour, time);
+    }
+
+    history->raw[history->rawNext] = value;
+    history->rawNext = (history->rawNext + 1) % HISTORY_RAW_SAMPLES;
+    if (history->rawCount < HISTORY_RAW_SAMPLES) history->rawCount++;
+
+    if (time - history->minute.startTime >= HISTORY_MINUTE_LENGTH && history->minute.count > 0) {
+        Aggregate minute = closeAccumulator(&history->minute);
+        history->minutes[history->minuteNext] = minute;
+        history->minuteNext = (history->minuteNext + 1) % HISTORY_MINUTES;
+        if (history->minuteCount < HISTORY_MINUTES) history->minuteCount++;
+        resetAccumulator(&history->minute, time);
+
+        //The hour tier is fed whole minutes so it never has to look at raw samples
+        accumulate(&history->hour, minute.min, minute.max, minute.avg);
+        if (history->hour.count >= HISTORY_MINUTES_PER_HOUR) {
+            history->hours[history->hourNext] = closeAccumulator(&history->hour);
+            history->hourNext = (history->hourNext + 1) % HISTORY_HOURS;
+            if (history->hourCount < HISTORY_HOURS) history->hourCount++;
+            resetAccumulator(&history->hour, time);
+        }
+    }
+    accumulate(&history->minute, value, value, value);
+}
+
+//Returns the number of entries a history tier holds
+unsigned int historyLength(History *history, HistoryTier tier) {
+    switch (tier) {
+        case HISTORY_RAW:
+            return history->rawCount;
+        case HISTORY_MINUTE:
+            return history->minuteCount;
+        default:
+            return history->hourCount;
+    }
+}
+
+//Copies the entry age steps back from the newest (age 0) of a history tier into entry
+//Returns FALSE if the tier does not hold that many entries
+Bool historyEntry(History *history, HistoryTier tier, unsigned int age, Aggregate *entry) {
+    if (age >= historyLength(history, tier)) {
+        return FALSE;
+    }
+    switch (tier) {
+        case HISTORY_RAW: {
+            unsigned short value = history->raw[(history->rawNext + HISTORY_RAW_SAMPLES - 1 - age) % HISTORY_RAW_SAMPLES];
+            entry->min = value;
+            entry->max = value;
+            entry->avg = value;
+            break;
+        }
+        case HISTORY_MINUTE:
+            *entry = history->minutes[(history->minuteNext + HISTORY_MINUTES - 1 - age) % HISTORY_MINUTES];
+            break;
+        default:
+            *entry = history->hours[(history->hourNext + HISTORY_HOURS - 1 - age) % HISTORY_HOURS];
+            break;
+    }
+    return TRUE;
+}
+
+//Returns the newest raw sample of a history, or fallback if it has none yet
+unsigned short latestSample(History *history, unsigned short fallback) {
+    Aggregate entry;
+    return historyEntry(history, HISTORY_RAW, 0, &entry) ? entry.avg : fallback;
+}
+
+//Encodes a batch of telemetry samples and writes it to the serial port as one frame
+void sendTelemetryBatch(unsigned short samples[][TELEMETRY_CHANNELS], int count) {
+    unsigned char buffer[1 + TELEMETRY_CHANNELS * TELEMETRY_BATCH_SAMPLES * 3];
+    int length = encodeTelemetryBatch(samples, count, buffer, sizeof(buffer));
+    if (length < 0 || length > 0xFF) { //Cannot happen for TELEMETRY_BATCH_SAMPLES up to 21
+        return;
+    }
+    sendFrame(FRAME_TELEMETRY_BATCH, buffer, (unsigned char) length);
+}
+
+//Writes one frame to the serial port straight from the payload buffer
+void sendFrame(unsigned char type, const unsigned char payload[], unsigned char length) {
+    unsigned short crc = frameCrc(type, payload, length);
+    Serial.write((uint8_t) FRAME_SYNC);
+    Serial.write((uint8_t) length);
+    Serial.write((uint8_t) type);
+    Serial.write(payload, (size_t) length);
+    Serial.write((uint8_t) (crc >> 8));
+    Serial.write((uint8_t) (crc & 0xFF));
+    addMetric(&SystemMetrics, METRIC_SERIAL_BYTES, length + FRAME_OVERHEAD);
+    TRACE(TRACE_SERIAL_WRITE, (unsigned char) min(length + FRAME_OVERHEAD, 255));
+}
+
+//Moves bytes the serial port has received into the uplink ring
+void receiveUplink(FrameRing *ring) {
+    while (Serial.available() > 0) {
+        frameRingPut(ring, (unsigned char) Serial.read());
+    }
+}
+
+//Dispatches every complete uplink frame waiting in the ring
+void serviceUplink(FrameRing *ring) {
+    FrameView frame;
+    while (frameNext(ring, &frame)) {
+        dispatchUplinkFrame(&frame);
+        frameRelease(ring, &frame);
+    }
+}
+
+//Applies one uplink command, reading its payload in place
+void dispatchUplinkFrame(const FrameView *frame) {
+    switch (frame->type) {
+        case FRAME_THRUST_COMMAND:
+            if (frame->length == 2) {
+                ThrusterControl = (unsigned int) frameByte(frame, 0) << 8 | frameByte(frame, 1);
+                ThrustCommandPending = TRUE;
+                addMetric(&SystemMetrics, METRIC_UPLINK_COMMANDS, 1);
+            }
+            break;
+        case FRAME_SET_MODE:
+            if (frame->length == 1) {
+                InStatusMode = frameByte(frame, 0) ? TRUE : FALSE;
+                addMetric(&SystemMetrics, METRIC_UPLINK_COMMANDS, 1);
+            }
+            break;
+        case FRAME_METRICS_REQUEST:
+            addMetric(&SystemMetrics, METRIC_UPLINK_COMMANDS, 1);
+            sendMetrics();
+            break;
+        default: //Unknown or downlink only types are ignored
+            break;
+    }
+}
+
+//Samples the gauges and sends every metric in a FRAME_METRICS frame
+void sendMetrics() {
+    uint64_t uptime = systemUptime();
+    setMetric(&SystemMetrics, METRIC_UPTIME, (uint32_t) uptime);
+    setMetric(&SystemMetrics, METRIC_UPTIME_WRAPS, (uint32_t) (uptime >> 32));
+    setMetric(&SystemMetrics, METRIC_BATTERY_LEVEL, BatteryLevel);
+    setMetric(&SystemMetrics, METRIC_FUEL_LEVEL, FuelLevel);
+    setMetric(&SystemMetrics, METRIC_DUTY_CYCLE, dutyCyclePermille(&SchedulerIdle, micros()));
+    //The kernel tick may be feeding the ring or counting, so everything is copied at one instant
+    //A 32 bit counter read while the tick updates it could otherwise go out half old and half new
+    Metrics snapshot;
+    noInterrupts();
+    setMetric(&SystemMetrics, METRIC_UPLINK_OVERFLOWS, UplinkRing.overflows);
+    setMetric(&SystemMetrics, METRIC_UPLINK_CRC_ERRORS, UplinkRing.crcErrors);
+    snapshot = SystemMetrics;
+    interrupts();
+    unsigned char payload[METRICS_DUMP_SIZE];
+    packMetrics(&snapshot, payload);
+    sendFrame(FRAME_METRICS, payload, METRICS_DUMP_SIZE);
+}
@@ -0,0 +1,41 @@
+# Writes a per-symbol RAM/flash usage report for a linked binary.
+# Run by the Lab2 post-build step when LAB2_MEMORY_REPORT is on:
+#   cmake -DNM=<nm> -DBINARY=<elf> -DREPORT=<output> -P memory_report.cmake
+
+execute_process(COMMAND ${NM} --print-size --size-sort --radix=d ${BINARY}
+        OUTPUT_VARIABLE symbols
+        RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${BINARY}")
+endif ()
+
+string(REPLACE "\n" ";" lines "${symbols}")
+set(ram_total 0)
+set(flash_total 0)
+set(ram_lines "")
+set(flash_lines "")
+foreach (line IN LISTS lines)
+    # <address> <size> <type> <name>
+    if (line MATCHES "^[0-9]+ 0*([0-9]+) ([A-Za-z]) (.+)$")
+        set(size ${CMAKE_MATCH_1})
+        set(type ${CMAKE_MATCH_2})
+        set(name ${CMAKE_MATCH_3})
+        if (type MATCHES "^[bBdDsSvV]$")
+            # Initialized data also takes flash for its initial values, it is counted with RAM here
+            math(EXPR ram_total "${ram_total} + ${size}")
+            string(APPEND ram_lines "${size}\t${type}\t${name}\n")
+        elseif (type MATCHES "^[tTrRwW]$")
+            math(EXPR flash_total "${flash_total} + ${size}")
+            string(APPEND flash_lines "${size}\t${type}\t${name}\n")
+        endif ()
+    endif ()
+endforeach ()
+
+file(WRITE ${REPORT}
+        "Memory report for ${BINARY}\n"
+        "RAM (static data and bss): ${ram_total} bytes\n"
+        "Flash (code and read only data): ${flash_total} bytes\n"
+        "Stack and heap are not included, build with MEASURE_STACK_DEPTH for per task stack use\n"
+        "\nRAM symbols, smallest first\nsize\ttype\tname\n${ram_lines}"
+        "\nFlash symbols, smallest first\nsize\ttype\tname\n${flash_lines}")
+message(STATUS "RAM ${ram_total} bytes, flash ${flash_total} bytes, details in ${REPORT}")
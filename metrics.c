@@ -0,0 +1,54 @@
+#include "metrics.h"
+
+//Zeroes every metric
+void resetMetrics(Metrics *metrics) {
+    for (unsigned int i = 0; i < METRIC_COUNT; i++) {
+        metrics->values[i] = 0;
+    }
+}
+
+//Writes a dump of metrics into out, which must hold METRICS_DUMP_SIZE bytes, and returns its length
+unsigned int packMetrics(const Metrics *metrics, unsigned char out[]) {
+    out[0] = METRIC_COUNT;
+    unsigned char *next = out + 1;
+    for (unsigned int i = 0; i < METRIC_COUNT; i++) {
+        uint32_t value = metrics->values[i];
+        next[0] = (unsigned char) (value >> 24);
+        next[1] = (unsigned char) (value >> 16);
+        next[2] = (unsigned char) (value >> 8);
+        next[3] = (unsigned char) value;
+        next += 4;
+    }
+    return METRICS_DUMP_SIZE;
+}
+
+//Reads a dump into metrics and returns how many metrics it held, metrics it did not hold are zeroed
+//A dump from a newer build may hold more metrics than this one knows, those are skipped
+int unpackMetrics(const unsigned char in[], unsigned int length, Metrics *metrics) {
+    if (length < 1 || length != 1 + 4 * (unsigned int) in[0]) {
+        return -1;
+    }
+    unsigned int count = in[0];
+    resetMetrics(metrics);
+    for (unsigned int i = 0; i < count && i < METRIC_COUNT; i++) {
+        const unsigned char *value = in + 1 + 4 * i;
+        metrics->values[i] = ((uint32_t) value[0] << 24) | ((uint32_t) value[1] << 16) | ((uint32_t) value[2] << 8) |
+                             value[3];
+    }
+    return (int) count;
+}
+
+#ifndef __AVR__
+static const char *const metricNames[METRIC_COUNT] = {
+        "task_runs_0", "task_runs_1", "task_runs_2", "task_runs_3", "task_runs_4", "task_runs_5",
+        "label_draws", "glyph_writes", "gauge_draws", "serial_bytes", "solar_toggles", "deadline_misses",
+        "uplink_commands", "checkpoints",
+        "uptime_ms", "battery_level", "fuel_level", "duty_cycle_permille", "uplink_overflows", "uplink_crc_errors",
+        "uptime_wraps"
+};
+
+//Returns the name of a metric, task run counters are named by slot
+const char *metricName(MetricId id) {
+    return (unsigned int) id < METRIC_COUNT ? metricNames[id] : "unknown";
+}
+#endif
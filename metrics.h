@@ -0,0 +1,84 @@
+//Fixed size registry of counters and gauges, dumped in binary over the serial link on request
+//The metric ids are shared with the ground tools, add new ones at the end so older dumps still decode
+//Plain C with no Arduino dependencies, the metric names are only built for the host
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Tasks the registry counts runs for, one counter per slot in the task queue
+#define METRIC_TASK_SLOTS 6
+
+enum MetricId {
+    //Counters, only ever incremented
+    METRIC_TASK_RUNS, //Then one per further task slot
+    METRIC_LABEL_DRAWS = METRIC_TASK_RUNS + METRIC_TASK_SLOTS,
+    METRIC_GLYPH_WRITES,
+    METRIC_GAUGE_DRAWS,
+    METRIC_SERIAL_BYTES, //Bytes of frames and console lines
+    METRIC_SOLAR_TOGGLES,
+    METRIC_DEADLINE_MISSES,
+    METRIC_UPLINK_COMMANDS,
+    METRIC_CHECKPOINTS,
+    //Gauges, sampled when the metrics are dumped
+    METRIC_UPTIME,
+    METRIC_BATTERY_LEVEL,
+    METRIC_FUEL_LEVEL,
+    METRIC_DUTY_CYCLE, //Tenths of a percent since the last stats summary
+    METRIC_UPLINK_OVERFLOWS,
+    METRIC_UPLINK_CRC_ERRORS,
+    METRIC_UPTIME_WRAPS, //Times METRIC_UPTIME wrapped, the high half of the 64 bit uptime
+    METRIC_COUNT
+};
+typedef enum MetricId MetricId;
+
+//The first gauge, everything before it is a counter
+#define METRIC_FIRST_GAUGE METRIC_UPTIME
+
+//Bytes of a dump, the metric count then every value high byte first in id order
+#define METRICS_DUMP_SIZE (1 + 4 * METRIC_COUNT)
+
+struct MetricsStruct {
+    uint32_t values[METRIC_COUNT];
+};
+typedef struct MetricsStruct Metrics;
+
+//Adds amount to a counter, a single 32 bit add so it is cheap anywhere on the hot path
+//The add is not atomic on AVR. A counter written from both the task loop and the kernel tick needs interrupts
+//disabled around the add, unless the writers already exclude each other, and a reader must copy the registry
+//with interrupts disabled
+static inline void addMetric(Metrics *metrics, MetricId id, uint32_t amount) {
+    metrics->values[id] += amount;
+}
+
+//Sets a gauge
+static inline void setMetric(Metrics *metrics, MetricId id, uint32_t value) {
+    metrics->values[id] = value;
+}
+
+//Zeroes every metric
+void resetMetrics(Metrics *metrics);
+
+//Writes a dump of metrics into out, which must hold METRICS_DUMP_SIZE bytes, and returns its length
+unsigned int packMetrics(const Metrics *metrics, unsigned char out[]);
+
+//Reads a dump into metrics and returns how many metrics it held, metrics it did not hold are zeroed
+//Returns -1 if the dump is malformed
+int unpackMetrics(const unsigned char in[], unsigned int length, Metrics *metrics);
+
+#ifndef __AVR__
+//Returns the name of a metric, task run counters are named by slot
+const char *metricName(MetricId id);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //METRICS_H
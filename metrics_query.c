@@ -0,0 +1,185 @@
+//Asks the satellite for its metrics over the serial link and prints them one per line as name and value
+//Usage: metrics_query [-w seconds] <serial device>   sends FRAME_METRICS_REQUEST and waits for the answer
+//       metrics_query -c <capture>                   prints every metrics dump found in a captured serial log
+//Console text and other frames on the link are skipped
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include "frame.h"
+#include "metrics.h"
+#include "crc.h"
+#include "hosttools.h"
+
+//Bytes kept while waiting for the answer, enough for a console page and a telemetry batch ahead of it
+#define RECEIVE_SIZE 4096
+
+//Prints one dump, returns 0 if it is malformed
+int printMetrics(const FrameSpan *frame) {
+    Metrics metrics;
+    int count = unpackMetrics(frame->payload, frame->length, &metrics);
+    if (count < 0) {
+        return 0;
+    }
+    for (int i = 0; i < count && i < METRIC_COUNT; i++) {
+        printf("%s %lu\n", metricName((MetricId) i), (unsigned long) metrics.values[i]);
+    }
+    if (count > METRIC_COUNT) {
+        printf("# %d newer metrics skipped\n", count - METRIC_COUNT);
+    }
+    return 1;
+}
+
+//Prints every dump in a capture file
+int scanCapture(const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return 1;
+    }
+    unsigned char *buffer = NULL;
+    unsigned long length = 0, capacity = 0;
+    size_t got;
+    do {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : RECEIVE_SIZE;
+            unsigned char *grown = realloc(buffer, capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "out of memory\n");
+                free(buffer);
+                fclose(in);
+                return 1;
+            }
+            buffer = grown;
+        }
+        got = fread(buffer + length, 1, capacity - length, in);
+        length += got;
+    } while (got > 0);
+    fclose(in);
+
+    FrameScanStats stats = {0, 0, 0};
+    FrameSpan frame;
+    unsigned long position = 0;
+    unsigned long dumps = 0;
+    while (frameScan(buffer, length, &position, &frame, &stats)) {
+        if (frame.type != FRAME_METRICS) {
+            continue;
+        }
+        if (dumps > 0) {
+            printf("\n");
+        }
+        if (printMetrics(&frame)) {
+            dumps++;
+        }
+    }
+    free(buffer);
+    if (dumps == 0) {
+        fprintf(stderr, "no metrics dumps in %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+//Opens a serial port raw at the satellite's 9600 baud, returns -1 on failure
+int openSerial(const char *device) {
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct termios settings;
+    if (tcgetattr(fd, &settings) == 0) { //Not a terminal when a file or pipe stands in for the port
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, B9600);
+        cfsetospeed(&settings, B9600);
+        settings.c_cc[VMIN] = 0;
+        settings.c_cc[VTIME] = 1; //Reads return after a tenth of a second of silence
+        tcsetattr(fd, TCSANOW, &settings);
+    }
+    return fd;
+}
+
+//Sends the request and prints the first dump that comes back within wait seconds
+int query(const char *device, double wait) {
+    int fd = openSerial(device);
+    if (fd < 0) {
+        perror(device);
+        return 1;
+    }
+    unsigned char request[FRAME_OVERHEAD];
+    packFrame(FRAME_METRICS_REQUEST, NULL, 0, request);
+    if (write(fd, request, sizeof(request)) != (ssize_t) sizeof(request)) {
+        perror(device);
+        close(fd);
+        return 1;
+    }
+
+    static unsigned char buffer[RECEIVE_SIZE];
+    unsigned long length = 0, position = 0;
+    FrameScanStats stats = {0, 0, 0};
+    FrameSpan frame;
+    double deadline = seconds() + wait;
+    while (seconds() < deadline) {
+        if (length == sizeof(buffer)) { //Keep only what may still start a frame
+            memmove(buffer, buffer + position, length - position);
+            length -= position;
+            position = 0;
+            if (length == sizeof(buffer)) {
+                length = position = 0;
+            }
+        }
+        ssize_t got = read(fd, buffer + length, sizeof(buffer) - length);
+        if (got < 0) {
+            perror(device);
+            break;
+        }
+        if (got == 0) {
+            usleep(10000);
+            continue;
+        }
+        length += (unsigned long) got;
+        while (frameScan(buffer, length, &position, &frame, &stats)) {
+            if (frame.type == FRAME_METRICS && printMetrics(&frame)) {
+                close(fd);
+                return 0;
+            }
+        }
+    }
+    close(fd);
+    fprintf(stderr, "no metrics from %s within %.1f s\n", device, wait);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *capture = NULL;
+    double wait = 3;
+    int option;
+    while ((option = getopt(argc, argv, "c:w:")) != -1) {
+        switch (option) {
+            case 'c':
+                capture = optarg;
+                break;
+            case 'w':
+                wait = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-w seconds] <serial device> | -c <capture>\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!crcSelfTest()) {
+        fprintf(stderr, "CRC self test failed\n");
+        return 1;
+    }
+    if (capture != NULL) {
+        return scanCapture(capture);
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-w seconds] <serial device> | -c <capture>\n", argv[0]);
+        return 1;
+    }
+    return query(argv[optind], wait);
+}
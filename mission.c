@@ -0,0 +1,216 @@
+#include "mission.h"
+
+//Puts the power model in its power on state
+void initPowerModel(PowerModelState *model) {
+    model->executionCount = 0;
+    model->consumptionIncreasing = TRUE;
+}
+
+//Runs the power model for one period
+void stepPowerModel(PowerModelState *model, Bool *solarPanelState, unsigned short *batteryLevel,
+                    unsigned short *powerConsumption, unsigned short *powerGeneration) {
+    unsigned int executionCount = model->executionCount;
+    //powerConsumption
+    if (model->consumptionIncreasing) {
+        if (executionCount % 2 == 0) {
+            *powerConsumption += 2;
+        } else {
+            *powerConsumption -= 1;
+        }
+        if (*powerConsumption > 10) {
+            model->consumptionIncreasing = FALSE;
+        }
+    } else {
+        if (executionCount % 2 == 0) {
+            *powerConsumption -= 2;
+        } else {
+            *powerConsumption += 1;
+        }
+        if (*powerConsumption < 5) {
+            model->consumptionIncreasing = TRUE;
+        }
+    }
+
+    //powerGeneration
+    if (*solarPanelState) {
+        if (*batteryLevel > 95) {
+            *solarPanelState = FALSE;
+            *powerGeneration = 0;
+        } else if (*batteryLevel < 50) {
+            //Increment the variable by 2 every even numbered time
+            if (executionCount % 2 == 0) {
+                *powerGeneration += 2;
+            } else { //Increment the variable by 1 every odd numbered time
+                *powerGeneration += 1;
+            }
+        } else {
+            //Increment the variable by 2 every even numbered time
+            if (executionCount % 2 == 0) {
+                *powerGeneration += 2;
+            }
+        }
+    } else {
+        if (*batteryLevel <= 10) {
+            *solarPanelState = TRUE;
+        }
+    }
+    //batteryLevel
+    if (*solarPanelState) { //If deployed
+        short result = (short) (*batteryLevel - *powerConsumption + *powerGeneration);
+        if (result < 0) {
+            *batteryLevel = 0;
+        } else {
+            *batteryLevel = result < 100 ? (unsigned short) result : 100;
+        }
+    } else { //If not deplyed
+        int result = *batteryLevel - 3 * *powerConsumption;
+        if (result < 0) {
+            *batteryLevel = 0;
+        } else {
+            *batteryLevel = (unsigned short) result;
+        }
+    }
+    model->executionCount++;
+}
+
+//Burns the fuel a thruster signal asks for
+void stepThrusterModel(unsigned int thrusterControl, unsigned short *fuelLevel) {
+    unsigned int duration = (thrusterControl & (0xFF00)) >> 8;
+    //Magnitude and direction do not matter yet, the thruster is either full on or off
+    unsigned int used = 4 * duration / 100;
+    *fuelLevel = *fuelLevel > used ? (unsigned short) (*fuelLevel - used) : 0;
+}
+
+//Returns a random integer between low and high inclusively and advances seed
+//Code taken from class website: https://class.ece.uw.edu/474/peckol/assignments/lab2/rand1.c
+//The seed is kept to 31 bits and scaled with integers, so the satellite, where double is a 32 bit float that could
+//round the seed's fraction up to 1, produces the same sequence as the host
+int randomIntegerFrom(int32_t *seed, int low, int high) {
+    uint32_t multiplier = 2743;
+    uint32_t addOn = 5923;
+
+    int retVal = 0;
+
+    if (low > high)
+        retVal = randomIntegerFrom(seed, high, low);
+    else {
+        //Only the low 31 bits of the seed ever reach them, so dropping the top bit leaves the sequence as it was
+        *seed = (int32_t) (((uint32_t) *seed * multiplier + addOn) & INT32_MAX);
+
+        //The seed as a fraction of 2^31 times the range, which is below high - low + 1
+        retVal = low + (int) (((uint64_t) (uint32_t) *seed * (uint32_t) (high - low + 1)) >> 31);
+    }
+
+    return retVal;
+}
+
+//Returns a random thruster signal and advances seed
+//Chooses a random direction, magnitude, and duration and shifts the bits to fit that information into 16 bits
+unsigned int randomThrustSignal(int32_t *seed) {
+    unsigned int signal = 1;
+    unsigned short direction = (unsigned short) randomIntegerFrom(seed, 0, 4);
+    if (direction == 4) //No thrust
+        return 0;
+    signal = signal << direction;
+    unsigned int magnitude = (unsigned int) randomIntegerFrom(seed, 0, 15);
+    unsigned int duration = (unsigned int) randomIntegerFrom(seed, 0, 255);
+
+    signal = signal | (magnitude << 4);
+    signal = signal | (duration << 8);
+    return signal;
+}
+
+//Puts a mission in the satellite's power on state with the given random seed
+void initMission(MissionState *mission, int32_t seed) {
+    mission->batteryLevel = 100;
+    mission->fuelLevel = 100;
+    mission->powerConsumption = 0;
+    mission->powerGeneration = 0;
+    mission->solarPanelState = FALSE;
+    mission->fuelLow = FALSE;
+    mission->batteryLow = FALSE;
+    mission->thrusterControl = 0;
+    initPowerModel(&mission->power);
+    mission->randomSeed = seed;
+    mission->periods = 0;
+}
+
+//Runs one period of a mission in the satellite's task order: power, thruster, coms, then the warnings
+void stepMission(MissionState *mission) {
+    stepPowerModel(&mission->power, &mission->solarPanelState, &mission->batteryLevel, &mission->powerConsumption,
+                   &mission->powerGeneration);
+    stepThrusterModel(mission->thrusterControl, &mission->fuelLevel);
+    mission->thrusterControl = randomThrustSignal(&mission->randomSeed);
+    mission->fuelLow = mission->fuelLevel <= MISSION_LOW_LEVEL ? TRUE : FALSE;
+    mission->batteryLow = mission->batteryLevel <= MISSION_LOW_LEVEL ? TRUE : FALSE;
+    mission->periods++;
+}
+
+//Flag bits of a snapshot
+#define SNAPSHOT_SOLAR_PANEL 0x01
+#define SNAPSHOT_FUEL_LOW 0x02
+#define SNAPSHOT_BATTERY_LOW 0x04
+#define SNAPSHOT_CONSUMPTION_INCREASING 0x08
+
+//Stores the low length bytes of value at buffer, least significant first
+static void putLittleEndian(unsigned char *buffer, uint32_t value, int length) {
+    for (int i = 0; i < length; i++) {
+        buffer[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+//Returns the length byte value stored at buffer, least significant first
+static uint32_t getLittleEndian(const unsigned char *buffer, int length) {
+    uint32_t value = 0;
+    for (int i = length - 1; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+//Encodes everything a mission carries into snapshot, the same bytes on the satellite and the host
+//Fixed widths and byte order, as int and long are smaller on the satellite than on the host
+void encodeMissionSnapshot(const MissionState *mission, unsigned char snapshot[MISSION_SNAPSHOT_SIZE]) {
+    unsigned char flags = 0;
+    flags |= mission->solarPanelState ? SNAPSHOT_SOLAR_PANEL : 0;
+    flags |= mission->fuelLow ? SNAPSHOT_FUEL_LOW : 0;
+    flags |= mission->batteryLow ? SNAPSHOT_BATTERY_LOW : 0;
+    flags |= mission->power.consumptionIncreasing ? SNAPSHOT_CONSUMPTION_INCREASING : 0;
+    snapshot[0] = MISSION_SNAPSHOT_VERSION;
+    snapshot[1] = flags;
+    putLittleEndian(&snapshot[2], mission->batteryLevel, 2);
+    putLittleEndian(&snapshot[4], mission->fuelLevel, 2);
+    putLittleEndian(&snapshot[6], mission->powerConsumption, 2);
+    putLittleEndian(&snapshot[8], mission->powerGeneration, 2);
+    putLittleEndian(&snapshot[10], mission->thrusterControl, 2);
+    putLittleEndian(&snapshot[12], (uint32_t) mission->power.executionCount, 4);
+    putLittleEndian(&snapshot[16], (uint32_t) mission->randomSeed, 4);
+    putLittleEndian(&snapshot[20], (uint32_t) mission->periods, 4);
+}
+
+//Decodes a snapshot into mission, returns FALSE and leaves mission alone if it has another layout version
+Bool decodeMissionSnapshot(const unsigned char snapshot[MISSION_SNAPSHOT_SIZE], MissionState *mission) {
+    if (snapshot[0] != MISSION_SNAPSHOT_VERSION) {
+        return FALSE;
+    }
+    unsigned char flags = snapshot[1];
+    mission->solarPanelState = flags & SNAPSHOT_SOLAR_PANEL ? TRUE : FALSE;
+    mission->fuelLow = flags & SNAPSHOT_FUEL_LOW ? TRUE : FALSE;
+    mission->batteryLow = flags & SNAPSHOT_BATTERY_LOW ? TRUE : FALSE;
+    mission->power.consumptionIncreasing = flags & SNAPSHOT_CONSUMPTION_INCREASING ? TRUE : FALSE;
+    mission->batteryLevel = (unsigned short) getLittleEndian(&snapshot[2], 2);
+    mission->fuelLevel = (unsigned short) getLittleEndian(&snapshot[4], 2);
+    mission->powerConsumption = (unsigned short) getLittleEndian(&snapshot[6], 2);
+    mission->powerGeneration = (unsigned short) getLittleEndian(&snapshot[8], 2);
+    mission->thrusterControl = (unsigned int) getLittleEndian(&snapshot[10], 2);
+    mission->power.executionCount = (unsigned int) getLittleEndian(&snapshot[12], 4);
+    mission->randomSeed = (int32_t) getLittleEndian(&snapshot[16], 4);
+    mission->periods = getLittleEndian(&snapshot[20], 4);
+    return TRUE;
+}
+
+//Starts branch as a copy of mission whose thrust commands are drawn from seed from here on
+void forkMission(const MissionState *mission, MissionState *branch, int32_t seed) {
+    *branch = *mission;
+    branch->randomSeed = seed;
+}
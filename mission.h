@@ -0,0 +1,84 @@
+//The satellite's power, thruster and thrust command models, free of the scheduler and hardware
+//Plain C with no Arduino dependencies so the host mission tools run exactly the model the satellite runs
+
+#ifndef MISSION_H
+#define MISSION_H
+
+#include <stdint.h>
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Fuel and battery levels at or below this raise the warnings
+#define MISSION_LOW_LEVEL 10
+
+//Bytes of an encoded mission snapshot
+#define MISSION_SNAPSHOT_SIZE 24
+//First byte of a snapshot, changed whenever the layout changes
+#define MISSION_SNAPSHOT_VERSION 1
+
+//What the power model carries from one period to the next
+struct PowerModelStateStruct {
+    //Count of the number times the model has run.
+    // It is okay if this number wraps to 0 because we just care about if the count is odd or even
+    unsigned int executionCount;
+    Bool consumptionIncreasing;
+};
+typedef struct PowerModelStateStruct PowerModelState;
+
+//Everything that changes over a mission, enough to run one period after another without the scheduler
+struct MissionStateStruct {
+    unsigned short batteryLevel;
+    unsigned short fuelLevel;
+    unsigned short powerConsumption;
+    unsigned short powerGeneration;
+    Bool solarPanelState;
+    Bool fuelLow;
+    Bool batteryLow;
+    unsigned int thrusterControl;
+    PowerModelState power;
+    int32_t randomSeed;
+    unsigned long periods; //Periods run so far
+};
+typedef struct MissionStateStruct MissionState;
+
+//Puts the power model in its power on state
+void initPowerModel(PowerModelState *model);
+
+//Runs the power model for one period
+void stepPowerModel(PowerModelState *model, Bool *solarPanelState, unsigned short *batteryLevel,
+                    unsigned short *powerConsumption, unsigned short *powerGeneration);
+
+//Burns the fuel a thruster signal asks for
+void stepThrusterModel(unsigned int thrusterControl, unsigned short *fuelLevel);
+
+//Returns a random integer between low and high inclusively and advances seed
+int randomIntegerFrom(int32_t *seed, int low, int high);
+
+//Returns a random thruster signal and advances seed
+//Chooses a random direction, magnitude, and duration and shifts the bits to fit that information into 16 bits
+unsigned int randomThrustSignal(int32_t *seed);
+
+//Puts a mission in the satellite's power on state with the given random seed
+void initMission(MissionState *mission, int32_t seed);
+
+//Runs one period of a mission in the satellite's task order: power, thruster, coms, then the warnings
+void stepMission(MissionState *mission);
+
+//Encodes everything a mission carries into snapshot, the same bytes on the satellite and the host
+void encodeMissionSnapshot(const MissionState *mission, unsigned char snapshot[MISSION_SNAPSHOT_SIZE]);
+
+//Decodes a snapshot into mission, returns FALSE and leaves mission alone if it has another layout version
+Bool decodeMissionSnapshot(const unsigned char snapshot[MISSION_SNAPSHOT_SIZE], MissionState *mission);
+
+//Starts branch as a copy of mission whose thrust commands are drawn from seed from here on
+//The thrust command already chosen for the next period is kept, so the branches part after it
+void forkMission(const MissionState *mission, MissionState *branch, int32_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //MISSION_H
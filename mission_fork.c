@@ -0,0 +1,163 @@
+//Flies one mission until its fuel falls to a fork level, snapshots it, and flies many branches on from the snapshot,
+//each with thrust commands drawn from its own seed, for exploring what-if futures without flying the prefix again
+//Usage: mission_fork [-s seed] [-f fork_fuel] [-n branches] [-b first_branch_seed] [-l periods] [-v]
+//  -f fuel      fuel level the mission is flown down to before it forks (default 50)
+//  -l periods   periods a branch is flown for unless the fuel runs out first (default 1000000)
+//  -v           also flies every branch from power on, prefix included, checks it ends in the same state
+//               and reports how much time the snapshot saved
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mission.h"
+#include "hosttools.h"
+
+//What one branch did after the fork
+struct BranchResultStruct {
+    unsigned long periods; //Periods flown after the fork
+    unsigned long fuelLowPeriod; //Periods after the fork until FuelLow, 0 if it was already low
+    unsigned long batteryLowPeriods; //Periods spent with BatteryLow
+    MissionState end;
+};
+typedef struct BranchResultStruct BranchResult;
+
+//Flies a branch until the fuel runs out or it has flown limit periods after the fork
+void flyBranch(MissionState *mission, unsigned long limit, BranchResult *result) {
+    unsigned long forkPeriods = mission->periods;
+    result->fuelLowPeriod = 0;
+    result->batteryLowPeriods = 0;
+    while (mission->fuelLevel > 0 && mission->periods - forkPeriods < limit) {
+        Bool wasFuelLow = mission->fuelLow;
+        stepMission(mission);
+        if (mission->fuelLow && !wasFuelLow && result->fuelLowPeriod == 0) {
+            result->fuelLowPeriod = mission->periods - forkPeriods;
+        }
+        if (mission->batteryLow) {
+            result->batteryLowPeriods++;
+        }
+    }
+    result->periods = mission->periods - forkPeriods;
+    result->end = *mission;
+}
+
+int main(int argc, char *argv[]) {
+    long seed = 1000;
+    unsigned short forkFuel = 50;
+    long branches = 10000;
+    long firstBranchSeed = 1;
+    unsigned long limit = 1000000;
+    Bool verify = FALSE;
+    int option;
+    while ((option = getopt(argc, argv, "s:f:n:b:l:v")) != -1) {
+        switch (option) {
+            case 's':
+                seed = atol(optarg);
+                break;
+            case 'f':
+                forkFuel = (unsigned short) atoi(optarg);
+                break;
+            case 'n':
+                branches = atol(optarg);
+                break;
+            case 'b':
+                firstBranchSeed = atol(optarg);
+                break;
+            case 'l':
+                limit = strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verify = TRUE;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s seed] [-f fork_fuel] [-n branches] [-b first_branch_seed] [-l periods]"
+                                " [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (branches <= 0) {
+        fprintf(stderr, "need at least one branch\n");
+        return 1;
+    }
+
+    //The common prefix, flown once
+    MissionState mission;
+    initMission(&mission, (int32_t) seed);
+    while (mission.fuelLevel > forkFuel) {
+        stepMission(&mission);
+    }
+    if (mission.fuelLevel == 0 && forkFuel > 0) {
+        fprintf(stderr, "the fuel ran out before the fork\n");
+        return 1;
+    }
+    unsigned char snapshot[MISSION_SNAPSHOT_SIZE];
+    encodeMissionSnapshot(&mission, snapshot);
+    unsigned long prefixPeriods = mission.periods;
+    printf("forked seed %ld at period %lu fuel %u battery %u, snapshot of %d bytes\n", seed, prefixPeriods,
+           mission.fuelLevel, mission.batteryLevel, MISSION_SNAPSHOT_SIZE);
+
+    BranchResult *results = malloc((size_t) branches * sizeof(BranchResult));
+    double *values = malloc((size_t) branches * sizeof(double));
+    if (results == NULL || values == NULL) {
+        fprintf(stderr, "out of memory for %ld branches\n", branches);
+        return 1;
+    }
+    double start = seconds();
+    for (long i = 0; i < branches; i++) {
+        MissionState fork, branch;
+        if (!decodeMissionSnapshot(snapshot, &fork)) {
+            fprintf(stderr, "snapshot has layout version %u\n", snapshot[0]);
+            return 1;
+        }
+        forkMission(&fork, &branch, (int32_t) (firstBranchSeed + i));
+        flyBranch(&branch, limit, &results[i]);
+    }
+    double forkedTime = seconds() - start;
+
+    printf("%ld branches\n", branches);
+    for (long i = 0; i < branches; i++) {
+        values[i] = (double) results[i].periods;
+    }
+    printDistribution("periods to fuel out", values, branches, branches);
+    long count = 0;
+    for (long i = 0; i < branches; i++) {
+        if (results[i].fuelLowPeriod > 0) {
+            values[count++] = (double) results[i].fuelLowPeriod;
+        }
+    }
+    printDistribution("periods to FuelLow", values, count, branches);
+    for (long i = 0; i < branches; i++) {
+        values[i] = (double) results[i].batteryLowPeriods;
+    }
+    printDistribution("periods BatteryLow", values, branches, branches);
+    fprintf(stderr, "branches from the snapshot in %.3f s\n", forkedTime);
+
+    int mismatch = 0;
+    if (verify) {
+        //The same branches flown from power on, the way a sweep without snapshots has to
+        start = seconds();
+        for (long i = 0; i < branches; i++) {
+            MissionState prefix, branch;
+            BranchResult result;
+            initMission(&prefix, (int32_t) seed);
+            while (prefix.periods < prefixPeriods) {
+                stepMission(&prefix);
+            }
+            forkMission(&prefix, &branch, (int32_t) (firstBranchSeed + i));
+            flyBranch(&branch, limit, &result);
+            unsigned char expected[MISSION_SNAPSHOT_SIZE], actual[MISSION_SNAPSHOT_SIZE];
+            encodeMissionSnapshot(&results[i].end, expected);
+            encodeMissionSnapshot(&result.end, actual);
+            if (memcmp(actual, expected, MISSION_SNAPSHOT_SIZE) != 0) {
+                fprintf(stderr, "branch %ld ended differently when flown from power on\n", i);
+                mismatch = 1;
+            }
+        }
+        double fullTime = seconds() - start;
+        fprintf(stderr, "branches from power on in %.3f s, the snapshot saved %.1f%%\n", fullTime,
+                fullTime > 0 ? 100.0 * (fullTime - forkedTime) / fullTime : 0.0);
+    }
+    free(values);
+    free(results);
+    return mismatch;
+}
@@ -0,0 +1,214 @@
+//Runs the satellite's mission model over many random seeds and task periods across every core
+//and reports how long the fuel and battery last, for sizing fuel margins
+//Usage: mission_sweep [-s first_seed] [-n seeds] [-d period_ms[,period_ms...]] [-l limit_s] [-j threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mission.h"
+#include "hosttools.h"
+
+//Most task periods one sweep takes with -d
+#define MAX_PERIODS 16
+//Runs a worker claims at a time, large enough that the claim lock is never contended
+#define CLAIM_CHUNK 64
+//Marks a level that never went low before the mission ended
+#define NEVER (-1.0)
+
+//What one mission did
+struct RunResultStruct {
+    double fuelLowTime; //Seconds until FuelLow, NEVER if it stayed high
+    double batteryLowTime; //Seconds until BatteryLow, NEVER if it stayed high
+    double endTime; //Seconds until the fuel ran out or the limit was reached
+    unsigned long solarDeploys;
+};
+typedef struct RunResultStruct RunResult;
+
+//The runs of a sweep and the next one to be claimed
+struct SweepStruct {
+    long firstSeed;
+    long seeds;
+    long periods[MAX_PERIODS];
+    int periodCount;
+    double limit; //Seconds of mission time before a run is stopped
+    RunResult *results; //periodCount blocks of seeds results
+    long nextRun;
+    pthread_mutex_t claimLock;
+};
+typedef struct SweepStruct Sweep;
+
+//Flies one mission from power on until the fuel runs out or the time limit is reached
+void runMission(int32_t seed, long periodMs, double limit, RunResult *result) {
+    MissionState mission;
+    initMission(&mission, seed);
+    result->fuelLowTime = NEVER;
+    result->batteryLowTime = NEVER;
+    result->solarDeploys = 0;
+    double period = periodMs / 1000.0;
+    double now = 0;
+    while (mission.fuelLevel > 0 && now < limit) {
+        Bool wasDeployed = mission.solarPanelState;
+        stepMission(&mission);
+        now = mission.periods * period;
+        if (mission.solarPanelState && !wasDeployed) {
+            result->solarDeploys++;
+        }
+        if (mission.fuelLow && result->fuelLowTime == NEVER) {
+            result->fuelLowTime = now;
+        }
+        if (mission.batteryLow && result->batteryLowTime == NEVER) {
+            result->batteryLowTime = now;
+        }
+    }
+    result->endTime = now;
+}
+
+//Claims runs in chunks and flies them until none are left
+void *sweepWorker(void *sweepPtr) {
+    Sweep *sweep = (Sweep *) sweepPtr;
+    long total = sweep->seeds * sweep->periodCount;
+    while (1) {
+        pthread_mutex_lock(&sweep->claimLock);
+        long first = sweep->nextRun;
+        sweep->nextRun += CLAIM_CHUNK;
+        pthread_mutex_unlock(&sweep->claimLock);
+        if (first >= total) {
+            return NULL;
+        }
+        long last = first + CLAIM_CHUNK < total ? first + CLAIM_CHUNK : total;
+        for (long run = first; run < last; run++) {
+            long periodIndex = run / sweep->seeds;
+            int32_t seed = (int32_t) (sweep->firstSeed + run % sweep->seeds);
+            runMission(seed, sweep->periods[periodIndex], sweep->limit, &sweep->results[run]);
+        }
+    }
+}
+
+//Prints the distributions of one task period's runs
+void report(const Sweep *sweep, int periodIndex, double values[]) {
+    const RunResult *results = &sweep->results[periodIndex * sweep->seeds];
+    long count;
+    printf("runDelay %ld ms\n", sweep->periods[periodIndex]);
+
+    count = 0;
+    for (long i = 0; i < sweep->seeds; i++) {
+        if (results[i].fuelLowTime != NEVER) {
+            values[count++] = results[i].fuelLowTime;
+        }
+    }
+    printDistribution("FuelLow (s)", values, count, sweep->seeds);
+
+    count = 0;
+    for (long i = 0; i < sweep->seeds; i++) {
+        if (results[i].batteryLowTime != NEVER) {
+            values[count++] = results[i].batteryLowTime;
+        }
+    }
+    printDistribution("BatteryLow (s)", values, count, sweep->seeds);
+
+    for (long i = 0; i < sweep->seeds; i++) {
+        values[i] = results[i].endTime;
+    }
+    printDistribution("mission end (s)", values, sweep->seeds, sweep->seeds);
+
+    for (long i = 0; i < sweep->seeds; i++) {
+        values[i] = (double) results[i].solarDeploys;
+    }
+    printDistribution("solar deploys", values, sweep->seeds, sweep->seeds);
+}
+
+//Reads a comma separated list of task periods into the sweep, returns 0 if it is malformed
+int parsePeriods(Sweep *sweep, char *list) {
+    sweep->periodCount = 0;
+    for (char *item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+        long period = atol(item);
+        if (period <= 0 || sweep->periodCount == MAX_PERIODS) {
+            return 0;
+        }
+        sweep->periods[sweep->periodCount++] = period;
+    }
+    return sweep->periodCount > 0;
+}
+
+int main(int argc, char *argv[]) {
+    Sweep sweep;
+    sweep.firstSeed = 1000;
+    sweep.seeds = 10000;
+    sweep.periods[0] = 5000;
+    sweep.periodCount = 1;
+    sweep.limit = 7 * 24 * 3600;
+    sweep.nextRun = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int option;
+    while ((option = getopt(argc, argv, "s:n:d:l:j:")) != -1) {
+        switch (option) {
+            case 's':
+                sweep.firstSeed = atol(optarg);
+                break;
+            case 'n':
+                sweep.seeds = atol(optarg);
+                break;
+            case 'd':
+                if (!parsePeriods(&sweep, optarg)) {
+                    fprintf(stderr, "-d takes up to %d positive periods in ms separated by commas\n", MAX_PERIODS);
+                    return 1;
+                }
+                break;
+            case 'l':
+                sweep.limit = atof(optarg);
+                break;
+            case 'j':
+                threads = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s first_seed] [-n seeds] [-d period_ms[,period_ms...]] [-l limit_s] [-j threads]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (sweep.seeds <= 0 || sweep.limit <= 0) {
+        fprintf(stderr, "need at least one seed and a positive time limit\n");
+        return 1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    long total = sweep.seeds * sweep.periodCount;
+    sweep.results = malloc((size_t) total * sizeof(RunResult));
+    double *values = malloc((size_t) sweep.seeds * sizeof(double));
+    pthread_t *workers = malloc((size_t) threads * sizeof(pthread_t));
+    if (sweep.results == NULL || values == NULL || workers == NULL) {
+        fprintf(stderr, "out of memory for %ld runs\n", total);
+        return 1;
+    }
+    pthread_mutex_init(&sweep.claimLock, NULL);
+
+    double start = seconds();
+    long started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, sweepWorker, &sweep) != 0) {
+            break;
+        }
+    }
+    if (started == 0) { //Fly them on this thread instead
+        sweepWorker(&sweep);
+    }
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double elapsed = seconds() - start;
+
+    for (int i = 0; i < sweep.periodCount; i++) {
+        report(&sweep, i, values);
+    }
+    fprintf(stderr, "%ld missions on %ld threads in %.2f s\n", total, started > 0 ? started : 1, elapsed);
+
+    pthread_mutex_destroy(&sweep.claimLock);
+    free(workers);
+    free(values);
+    free(sweep.results);
+    return 0;
+}
@@ -0,0 +1,33 @@
+//Stackless coroutines for tasks that spread one release's work over several scheduler passes
+//A protothread remembers the line it yielded at and jumps back there the next time its task function is called
+//Locals do not survive a yield, keep anything needed after one in static or task data
+//Built on a switch, so a protothread must not yield from inside a switch of its own
+//Plain C with no Arduino dependencies
+
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+struct ProtothreadStruct {
+    unsigned short resumeLine; //0 when the protothread is not in the middle of its work
+};
+typedef struct ProtothreadStruct Protothread;
+
+//Starts the protothread from the top on its next call
+#define PT_INIT(pt) ((pt)->resumeLine = 0)
+
+//True while the protothread has yielded and has work left
+#define PT_RUNNING(pt) ((pt)->resumeLine != 0)
+
+//Opens the body of a protothread, everything before it runs on every call
+#define PT_BEGIN(pt) switch ((pt)->resumeLine) { case 0:
+
+//Returns from the task function, the next call carries on from here
+#define PT_YIELD(pt) do { (pt)->resumeLine = __LINE__; return; case __LINE__:; } while (0)
+
+//Finishes the work early, the next call starts from the top
+#define PT_EXIT(pt) do { (pt)->resumeLine = 0; return; } while (0)
+
+//Closes the body of a protothread, the next call starts from the top
+#define PT_END(pt) } (pt)->resumeLine = 0
+
+#endif //PROTOTHREAD_H
@@ -0,0 +1,65 @@
+#include "reactive.h"
+
+//Makes signal a source that follows variable
+void initSourceSignal(Signal *signal, const unsigned short *variable) {
+    signal->value = 0;
+    signal->valid = FALSE;
+    signal->variable = variable;
+    signal->function = 0;
+    signal->inputCount = 0;
+    signal->subscriber = 0;
+    signal->context = 0;
+}
+
+//Makes signal the value of function over inputCount inputs, which must not depend on signal
+void initDerivedSignal(Signal *signal, SignalFunction function, Signal *const inputs[], unsigned char inputCount) {
+    initSourceSignal(signal, 0);
+    signal->function = function;
+    if (inputCount > REACTIVE_MAX_INPUTS) {
+        inputCount = REACTIVE_MAX_INPUTS;
+    }
+    for (unsigned char i = 0; i < inputCount; i++) {
+        signal->inputs[i] = inputs[i];
+        signal->inputValues[i] = 0;
+    }
+    signal->inputCount = inputCount;
+}
+
+//Sets the one subscriber told when signal changes, 0x0 removes it
+void subscribeSignal(Signal *signal, SignalSubscriber subscriber, void *context) {
+    signal->subscriber = subscriber;
+    signal->context = context;
+}
+
+//Stores value as the signal's value and tells the subscriber if that is a change
+static void updateSignal(Signal *signal, unsigned short value) {
+    if (signal->valid && signal->value == value) {
+        return;
+    }
+    signal->value = value;
+    signal->valid = TRUE;
+    if (signal->subscriber != 0) {
+        signal->subscriber(value, signal->context);
+    }
+}
+
+//Returns the current value of signal, bringing it and its inputs up to date first
+//A derived signal whose inputs all read the same as last time costs one comparison per input
+unsigned short readSignal(Signal *signal) {
+    if (signal->variable != 0) {
+        updateSignal(signal, *signal->variable);
+        return signal->value;
+    }
+    Bool inputChanged = signal->valid ? FALSE : TRUE;
+    for (unsigned char i = 0; i < signal->inputCount; i++) {
+        unsigned short input = readSignal(signal->inputs[i]);
+        if (input != signal->inputValues[i]) {
+            signal->inputValues[i] = input;
+            inputChanged = TRUE;
+        }
+    }
+    if (inputChanged) {
+        updateSignal(signal, signal->function(signal->inputValues));
+    }
+    return signal->value;
+}
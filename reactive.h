@@ -0,0 +1,54 @@
+//A small pull based dataflow graph for values derived from the system state
+//A source signal follows a variable. A derived signal caches a function of up to REACTIVE_MAX_INPUTS other signals
+//and is recomputed only when a read finds that one of those inputs changed
+//Plain C with no Arduino dependencies so it builds for both the satellite and the host tools
+
+#ifndef REACTIVE_H
+#define REACTIVE_H
+
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Most inputs one derived signal can have
+#define REACTIVE_MAX_INPUTS 2
+
+typedef struct SignalStruct Signal;
+
+//Computes a derived value from the current values of its inputs, in the order they were given
+typedef unsigned short (*SignalFunction)(const unsigned short inputs[]);
+
+//Called with the new value whenever a read finds that a signal changed, and on its first read
+typedef void (*SignalSubscriber)(unsigned short value, void *context);
+
+struct SignalStruct {
+    unsigned short value;
+    Bool valid; //value has been read or computed at least once
+    const unsigned short *variable; //What a source signal follows, 0x0 for a derived signal
+    SignalFunction function;
+    Signal *inputs[REACTIVE_MAX_INPUTS];
+    unsigned short inputValues[REACTIVE_MAX_INPUTS]; //Input values that value was computed from
+    unsigned char inputCount;
+    SignalSubscriber subscriber;
+    void *context;
+};
+
+//Makes signal a source that follows variable
+void initSourceSignal(Signal *signal, const unsigned short *variable);
+
+//Makes signal the value of function over inputCount inputs, which must not depend on signal
+void initDerivedSignal(Signal *signal, SignalFunction function, Signal *const inputs[], unsigned char inputCount);
+
+//Sets the one subscriber told when signal changes, 0x0 removes it
+void subscribeSignal(Signal *signal, SignalSubscriber subscriber, void *context);
+
+//Returns the current value of signal, bringing it and its inputs up to date first
+unsigned short readSignal(Signal *signal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REACTIVE_H
@@ -0,0 +1,183 @@
+#include "registry.h"
+#include "timebase.h"
+
+//Returns nonzero if a is due before b, entries released at the same time keep their registration order
+//Compared across the wrap of millis(), so every queued release must be within about 24 days of the others
+static int releasedBefore(const ScheduleEntry *a, const ScheduleEntry *b) {
+    if (a->releaseTime != b->releaseTime) {
+        return timeBefore(a->releaseTime, b->releaseTime);
+    }
+    return a->id < b->id;
+}
+
+//Stores entry at position i of the ready queue
+static void placeReady(TaskRegistry *registry, unsigned int i, ScheduleEntry *entry) {
+    registry->ready[i] = entry;
+    entry->queueIndex = i;
+}
+
+//Moves the entry at position i up the heap until its parent is due no later than it
+static void siftUp(TaskRegistry *registry, unsigned int i) {
+    ScheduleEntry *entry = registry->ready[i];
+    while (i > 0) {
+        unsigned int parent = (i - 1) / 2;
+        if (!releasedBefore(entry, registry->ready[parent])) {
+            break;
+        }
+        placeReady(registry, i, registry->ready[parent]);
+        i = parent;
+    }
+    placeReady(registry, i, entry);
+}
+
+//Moves the entry at position i down the heap until both children are due no earlier than it
+static void siftDown(TaskRegistry *registry, unsigned int i) {
+    ScheduleEntry *entry = registry->ready[i];
+    unsigned int count = registry->readyCount;
+    while (1) {
+        unsigned int child = 2 * i + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && releasedBefore(registry->ready[child + 1], registry->ready[child])) {
+            child++;
+        }
+        if (!releasedBefore(registry->ready[child], entry)) {
+            break;
+        }
+        placeReady(registry, i, registry->ready[child]);
+        i = child;
+    }
+    placeReady(registry, i, entry);
+}
+
+//Takes the entry at position i out of the ready queue
+static void removeReady(TaskRegistry *registry, unsigned int i) {
+    registry->readyCount--;
+    if (i == registry->readyCount) {
+        return;
+    }
+    placeReady(registry, i, registry->ready[registry->readyCount]);
+    if (i > 0 && releasedBefore(registry->ready[i], registry->ready[(i - 1) / 2])) {
+        siftUp(registry, i);
+    } else {
+        siftDown(registry, i);
+    }
+}
+
+//Puts entry in the ready queue or the polled list
+static void queueEntry(TaskRegistry *registry, ScheduleEntry *entry) {
+    entry->state = SCHEDULE_QUEUED;
+    if (entry->polled) {
+        entry->queueIndex = registry->polledCount;
+        registry->polled[registry->polledCount++] = entry;
+    } else {
+        registry->ready[registry->readyCount] = entry;
+        siftUp(registry, registry->readyCount++);
+    }
+}
+
+//Takes a queued entry out of the ready queue or the polled list, the order of the polled list is not kept
+static void dequeueEntry(TaskRegistry *registry, ScheduleEntry *entry) {
+    if (entry->polled) {
+        ScheduleEntry *last = registry->polled[--registry->polledCount];
+        registry->polled[entry->queueIndex] = last;
+        last->queueIndex = entry->queueIndex;
+    } else {
+        removeReady(registry, entry->queueIndex);
+    }
+}
+
+//Empties registry
+void initTaskRegistry(TaskRegistry *registry) {
+    registry->count = 0;
+    registry->readyCount = 0;
+    registry->polledCount = 0;
+    registry->nextId = 0;
+}
+
+//Adds entry for owner and queues it, its releaseTime and polled must already be set
+//Returns FALSE if the registry is full
+Bool registerTask(TaskRegistry *registry, ScheduleEntry *entry, void *owner) {
+    if (registry->count == TASK_REGISTRY_CAPACITY) {
+        return FALSE;
+    }
+    entry->owner = owner;
+    entry->id = registry->nextId++;
+    entry->index = registry->count;
+    registry->entries[registry->count++] = entry;
+    queueEntry(registry, entry);
+    return TRUE;
+}
+
+//Takes entry out of the registry, it may be taken for the current pass and is then not run again
+void unregisterTask(TaskRegistry *registry, ScheduleEntry *entry) {
+    if (entry->state == SCHEDULE_REMOVED) {
+        return;
+    }
+    suspendTask(registry, entry);
+    ScheduleEntry *last = registry->entries[--registry->count];
+    registry->entries[entry->index] = last;
+    last->index = entry->index;
+    entry->state = SCHEDULE_REMOVED;
+}
+
+//Stops entry being taken until it is resumed
+//A taken entry keeps its place in the pass so the rest of the pass can still be walked, it is skipped there
+void suspendTask(TaskRegistry *registry, ScheduleEntry *entry) {
+    if (entry->state == SCHEDULE_QUEUED) {
+        dequeueEntry(registry, entry);
+    }
+    if (entry->state != SCHEDULE_REMOVED) {
+        entry->state = SCHEDULE_SUSPENDED;
+    }
+}
+
+//Queues a suspended entry again with the given release time
+void resumeTask(TaskRegistry *registry, ScheduleEntry *entry, unsigned long releaseTime) {
+    if (entry->state != SCHEDULE_SUSPENDED) {
+        return;
+    }
+    entry->releaseTime = releaseTime;
+    queueEntry(registry, entry);
+}
+
+//Takes every timed entry released by now, in release order, then every polled entry
+//Returns the first, the rest follow through next. Each must be run only if it is still SCHEDULE_TAKEN
+//and then given back with requeueTask
+ScheduleEntry *takeReleasedTasks(TaskRegistry *registry, unsigned long now) {
+    ScheduleEntry *first = 0;
+    ScheduleEntry **link = &first;
+    while (registry->readyCount > 0 && timeReached(now, registry->ready[0]->releaseTime)) {
+        ScheduleEntry *entry = registry->ready[0];
+        removeReady(registry, 0);
+        entry->state = SCHEDULE_TAKEN;
+        *link = entry;
+        link = &entry->next;
+    }
+    for (unsigned int i = 0; i < registry->polledCount; i++) {
+        ScheduleEntry *entry = registry->polled[i];
+        entry->state = SCHEDULE_TAKEN;
+        *link = entry;
+        link = &entry->next;
+    }
+    registry->polledCount = 0;
+    *link = 0;
+    return first;
+}
+
+//Queues an entry taken by takeReleasedTasks again at its releaseTime, unless it was suspended or removed meanwhile
+void requeueTask(TaskRegistry *registry, ScheduleEntry *entry) {
+    if (entry->state == SCHEDULE_TAKEN) {
+        queueEntry(registry, entry);
+    }
+}
+
+//Sets *releaseTime to the earliest release of a queued timed entry, returns FALSE if there is none
+Bool earliestRelease(const TaskRegistry *registry, unsigned long *releaseTime) {
+    if (registry->readyCount == 0) {
+        return FALSE;
+    }
+    *releaseTime = registry->ready[0]->releaseTime;
+    return TRUE;
+}
@@ -0,0 +1,85 @@
+//Runtime registry of the tasks a scheduler runs, with a binary heap ready queue ordered by release time
+//Tasks can be added, removed, suspended and resumed while the scheduler runs. A pass takes only the tasks that are
+//due, so it costs O(log n) per dispatch instead of a walk over every task
+//Entries are owned by the caller, usually embedded in its task control block, so the registry never allocates
+//Plain C with no Arduino dependencies so the host benchmark measures the same code
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Most tasks one registry holds, three pointers of RAM each
+#ifndef TASK_REGISTRY_CAPACITY
+#define TASK_REGISTRY_CAPACITY 8
+#endif
+
+//Where an entry is
+enum ScheduleState {
+    SCHEDULE_QUEUED, //Waiting in the ready queue or the polled list
+    SCHEDULE_TAKEN, //Taken for the current pass and not yet requeued
+    SCHEDULE_SUSPENDED,
+    SCHEDULE_REMOVED
+};
+typedef enum ScheduleState ScheduleState;
+
+typedef struct ScheduleEntryStruct ScheduleEntry;
+
+struct ScheduleEntryStruct {
+    unsigned long releaseTime; //When a timed entry is next due, in millis() time that may wrap. Changed only while taken
+    Bool polled; //Taken on every pass instead of at its release time
+    unsigned char state;
+    unsigned int id; //Registration order, breaks ties between entries released at the same time
+    unsigned int index; //Position in the registry's list of entries
+    unsigned int queueIndex; //Position in the ready queue or the polled list
+    ScheduleEntry *next; //Next entry taken in the same pass
+    void *owner; //The task the entry schedules
+};
+
+struct TaskRegistryStruct {
+    ScheduleEntry *entries[TASK_REGISTRY_CAPACITY]; //Every registered entry, in no particular order
+    ScheduleEntry *ready[TASK_REGISTRY_CAPACITY]; //Timed entries that are queued, a min heap on releaseTime then id
+    ScheduleEntry *polled[TASK_REGISTRY_CAPACITY]; //Polled entries that are queued
+    unsigned int count;
+    unsigned int readyCount;
+    unsigned int polledCount;
+    unsigned int nextId;
+};
+typedef struct TaskRegistryStruct TaskRegistry;
+
+//Empties registry
+void initTaskRegistry(TaskRegistry *registry);
+
+//Adds entry for owner and queues it, its releaseTime and polled must already be set
+//Returns FALSE if the registry is full
+Bool registerTask(TaskRegistry *registry, ScheduleEntry *entry, void *owner);
+
+//Takes entry out of the registry, it may be taken for the current pass and is then not run again
+void unregisterTask(TaskRegistry *registry, ScheduleEntry *entry);
+
+//Stops entry being taken until it is resumed
+void suspendTask(TaskRegistry *registry, ScheduleEntry *entry);
+
+//Queues a suspended entry again with the given release time
+void resumeTask(TaskRegistry *registry, ScheduleEntry *entry, unsigned long releaseTime);
+
+//Takes every timed entry released by now, in release order, then every polled entry
+//Returns the first, the rest follow through next. Each must be run only if it is still SCHEDULE_TAKEN
+//and then given back with requeueTask
+ScheduleEntry *takeReleasedTasks(TaskRegistry *registry, unsigned long now);
+
+//Queues an entry taken by takeReleasedTasks again at its releaseTime, unless it was suspended or removed meanwhile
+void requeueTask(TaskRegistry *registry, ScheduleEntry *entry);
+
+//Sets *releaseTime to the earliest release of a queued timed entry, returns FALSE if there is none
+Bool earliestRelease(const TaskRegistry *registry, unsigned long *releaseTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REGISTRY_H
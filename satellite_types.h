@@ -0,0 +1,11 @@
+//Types shared by the satellite sketch and the plain C modules it is built from
+
+#ifndef SATELLITE_TYPES_H
+#define SATELLITE_TYPES_H
+
+enum myBool {
+    FALSE = 0, TRUE = 1
+};
+typedef enum myBool Bool;
+
+#endif //SATELLITE_TYPES_H
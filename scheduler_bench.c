@@ -0,0 +1,222 @@
+//Measures how the task registry's ready queue scales against the walk over every task it replaced
+//Runs synthetic periodic tasks on a simulated clock that jumps to the next release, the way the scheduler sleeps,
+//and times the passes both ways on the host. Both ways must dispatch the same tasks at the same times
+//Usage: scheduler_bench [-n tasks[,tasks...]] [-p passes] [-s seed] [-r permille] [-t start_ms]
+//       -r suspends or resumes a random task on that share of passes, to time the registry under churn
+//       -t starts the simulated clock there instead of at 0. The clock wraps at 32 bits like millis(), so a start
+//          just short of the wrap, such as 4294907295, checks both ways schedule across it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "registry.h"
+#include "timebase.h"
+#include "hosttools.h"
+
+//Most task counts one run takes with -n
+#define MAX_COUNTS 16
+//Task periods are drawn from this range of milliseconds
+#define MIN_PERIOD 10
+#define MAX_PERIOD 1000
+
+//A synthetic task, scheduled by the registry through entry and by the walk through nextReleaseTime
+struct BenchTaskStruct {
+    ScheduleEntry entry;
+    unsigned long period;
+    uint32_t nextReleaseTime;
+    Bool suspended;
+    unsigned long runs;
+};
+typedef struct BenchTaskStruct BenchTask;
+
+//What one way of scheduling did
+struct BenchResultStruct {
+    unsigned long long dispatches;
+    unsigned long long checksum; //Sum of task index times the 32 bit release time over every dispatch
+    double elapsed;
+};
+typedef struct BenchResultStruct BenchResult;
+
+//Returns the next number of a small generator, so both ways see the same churn without sharing rand()
+unsigned long nextRandom(unsigned long *state) {
+    *state = *state * 1103515245UL + 12345UL;
+    return (*state >> 16) & 0x7FFF;
+}
+
+//Gives every task a random period and a first release within it of clockStart
+void initTasks(BenchTask tasks[], int count, unsigned long seed, uint32_t clockStart) {
+    unsigned long state = seed;
+    for (int i = 0; i < count; i++) {
+        tasks[i].period = MIN_PERIOD + nextRandom(&state) % (MAX_PERIOD - MIN_PERIOD + 1);
+        tasks[i].nextReleaseTime = clockStart + (uint32_t) (nextRandom(&state) % tasks[i].period);
+        tasks[i].suspended = FALSE;
+        tasks[i].runs = 0;
+    }
+}
+
+//The task's work, kept out of line so both ways pay the same for it
+__attribute__((noinline)) void runTask(BenchTask *task, int index, unsigned long releaseTime, BenchResult *result) {
+    task->runs++;
+    result->dispatches++;
+    result->checksum += (unsigned long long) index * (uint32_t) releaseTime;
+}
+
+//Schedules the tasks the old way, every pass walks them all to run the released ones and again to find the next wake
+void runWalk(BenchTask tasks[], int count, long passes, unsigned long seed, long churn, uint32_t clockStart,
+             BenchResult *result) {
+    unsigned long state = seed;
+    uint32_t now = clockStart;
+    memset(result, 0, sizeof(BenchResult));
+    double start = seconds();
+    for (long pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < count; i++) {
+            BenchTask *task = &tasks[i];
+            if (task->suspended || !timeReached(now, task->nextReleaseTime)) {
+                continue;
+            }
+            runTask(task, i, task->nextReleaseTime, result);
+            task->nextReleaseTime += task->period;
+        }
+        if ((long) (nextRandom(&state) % 1000) < churn) {
+            BenchTask *task = &tasks[nextRandom(&state) % (unsigned long) count];
+            if (task->suspended) {
+                task->suspended = FALSE;
+                task->nextReleaseTime = now + task->period;
+            } else {
+                task->suspended = TRUE;
+            }
+        }
+        uint32_t wakeTime = now + MAX_PERIOD;
+        for (int i = 0; i < count; i++) {
+            if (!tasks[i].suspended && timeBefore(tasks[i].nextReleaseTime, wakeTime)) {
+                wakeTime = tasks[i].nextReleaseTime;
+            }
+        }
+        now = wakeTime;
+    }
+    result->elapsed = seconds() - start;
+}
+
+//Schedules the tasks through the registry, every pass takes only the released ones from the ready queue
+void runRegistry(TaskRegistry *registry, BenchTask tasks[], int count, long passes, unsigned long seed, long churn,
+                 uint32_t clockStart, BenchResult *result) {
+    unsigned long state = seed;
+    uint32_t now = clockStart;
+    initTaskRegistry(registry);
+    for (int i = 0; i < count; i++) {
+        tasks[i].entry.releaseTime = tasks[i].nextReleaseTime;
+        tasks[i].entry.polled = FALSE;
+        registerTask(registry, &tasks[i].entry, &tasks[i]);
+    }
+    memset(result, 0, sizeof(BenchResult));
+    double start = seconds();
+    for (long pass = 0; pass < passes; pass++) {
+        ScheduleEntry *entry = takeReleasedTasks(registry, now);
+        while (entry != 0) {
+            ScheduleEntry *next = entry->next;
+            BenchTask *task = (BenchTask *) entry->owner;
+            runTask(task, (int) (task - tasks), entry->releaseTime, result);
+            entry->releaseTime += task->period;
+            requeueTask(registry, entry);
+            entry = next;
+        }
+        if ((long) (nextRandom(&state) % 1000) < churn) {
+            BenchTask *task = &tasks[nextRandom(&state) % (unsigned long) count];
+            if (task->entry.state == SCHEDULE_SUSPENDED) {
+                resumeTask(registry, &task->entry, now + task->period);
+            } else {
+                suspendTask(registry, &task->entry);
+            }
+        }
+        uint32_t wakeTime = now + MAX_PERIOD;
+        unsigned long releaseTime;
+        if (earliestRelease(registry, &releaseTime) && timeBefore(releaseTime, wakeTime)) {
+            wakeTime = (uint32_t) releaseTime;
+        }
+        now = wakeTime;
+    }
+    result->elapsed = seconds() - start;
+}
+
+//Reads a comma separated list of task counts, returns how many there were or 0 if it is malformed
+int parseCounts(char *list, int counts[]) {
+    int found = 0;
+    for (char *item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+        int count = atoi(item);
+        if (count <= 0 || count > TASK_REGISTRY_CAPACITY || found == MAX_COUNTS) {
+            return 0;
+        }
+        counts[found++] = count;
+    }
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    int counts[MAX_COUNTS] = {10, 30, 100, 300, 1000};
+    int countCount = 5;
+    long passes = 200000;
+    unsigned long seed = 1000;
+    long churn = 0;
+    uint32_t clockStart = 0;
+    int option;
+    while ((option = getopt(argc, argv, "n:p:s:r:t:")) != -1) {
+        switch (option) {
+            case 'n':
+                countCount = parseCounts(optarg, counts);
+                if (countCount == 0) {
+                    fprintf(stderr, "-n takes up to %d task counts of 1 to %d separated by commas\n", MAX_COUNTS,
+                            TASK_REGISTRY_CAPACITY);
+                    return 1;
+                }
+                break;
+            case 'p':
+                passes = atol(optarg);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                churn = atol(optarg);
+                break;
+            case 't':
+                clockStart = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n tasks[,tasks...]] [-p passes] [-s seed] [-r permille] [-t start_ms]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (passes <= 0) {
+        fprintf(stderr, "need a positive number of passes\n");
+        return 1;
+    }
+
+    static TaskRegistry registry;
+    BenchTask *tasks = malloc(TASK_REGISTRY_CAPACITY * sizeof(BenchTask));
+    if (tasks == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    printf("%6s %12s %14s %14s %14s %8s\n", "tasks", "dispatches", "walk ns/pass", "queue ns/pass", "queue ns/run",
+           "speedup");
+    int mismatch = 0;
+    for (int i = 0; i < countCount; i++) {
+        int count = counts[i];
+        BenchResult walk, queue;
+        initTasks(tasks, count, seed, clockStart);
+        runWalk(tasks, count, passes, seed, churn, clockStart, &walk);
+        initTasks(tasks, count, seed, clockStart);
+        runRegistry(&registry, tasks, count, passes, seed, churn, clockStart, &queue);
+        if (walk.dispatches != queue.dispatches || walk.checksum != queue.checksum) {
+            fprintf(stderr, "%d tasks: the ready queue dispatched differently from the walk\n", count);
+            mismatch = 1;
+        }
+        printf("%6d %12llu %14.1f %14.1f %14.1f %7.1fx\n", count, queue.dispatches, walk.elapsed * 1e9 / passes,
+               queue.elapsed * 1e9 / passes, queue.dispatches > 0 ? queue.elapsed * 1e9 / queue.dispatches : 0.0,
+               queue.elapsed > 0 ? walk.elapsed / queue.elapsed : 0.0);
+    }
+    free(tasks);
+    return mismatch;
+}
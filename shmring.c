@@ -0,0 +1,226 @@
+#define _DEFAULT_SOURCE
+#include "shmring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Marks a mapping whose header has been filled in, stored last by the producer
+#define SHM_RING_MAGIC 0x53524E47u
+//Records start on multiples of this, so a record header always fits before the end of the record space
+#define RECORD_ALIGN 8
+//Smallest record space, large enough for the largest record even when it has to wrap, so every reserve can succeed
+#define MIN_CAPACITY (1UL << 18)
+
+//What precedes every record's payload
+struct RecordHeaderStruct {
+    uint16_t length;
+    uint8_t type;
+    uint8_t wrap; //Nonzero marks the unused end of the record space, the next record is at the start
+};
+typedef struct RecordHeaderStruct RecordHeader;
+
+//Returns the ring space a record of length payload bytes takes
+static uint64_t recordSize(unsigned int length) {
+    return (sizeof(RecordHeader) + length + RECORD_ALIGN - 1) & ~(uint64_t) (RECORD_ALIGN - 1);
+}
+
+//Creates the ring called name with at least capacity bytes of record space, replacing any old one
+//name is a shm_open name such as "/telemetry". Returns FALSE and sets errno on failure
+Bool shmRingCreate(ShmRing *ring, const char *name, unsigned long capacity) {
+    uint32_t size = MIN_CAPACITY;
+    while (size < capacity && size < (1UL << 31)) {
+        size <<= 1;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return FALSE;
+    }
+    ring->mappedSize = sizeof(ShmRingHeader) + size;
+    if (ftruncate(fd, (off_t) ring->mappedSize) < 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = error;
+        return FALSE;
+    }
+    void *mapping = mmap(0x0, ring->mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return FALSE;
+    }
+    ring->header = (ShmRingHeader *) mapping;
+    ring->header->capacity = size;
+    ring->header->closed = 0;
+    ring->header->producer = (uint32_t) getpid();
+    ring->header->consumer = 0;
+    ring->header->full = 0;
+    ring->header->head = 0;
+    ring->header->tail = 0;
+    __atomic_store_n(&ring->header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    ring->otherIndex = 0;
+    ring->skipped = 0;
+    ring->record = 0x0;
+    return TRUE;
+}
+
+//Returns whether the process with id pid still exists
+static Bool processAlive(uint32_t pid) {
+    return kill((pid_t) pid, 0) == 0 || errno != ESRCH ? TRUE : FALSE;
+}
+
+//Opens the ring called name that a producer created and claims it as its consumer
+//Returns FALSE and sets errno if there is none yet, EBUSY if another consumer already claimed it, or ESRCH if its
+//producer died without closing it
+Bool shmRingOpen(ShmRing *ring, const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return FALSE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(ShmRingHeader)) { //Still being created
+        close(fd);
+        errno = EAGAIN;
+        return FALSE;
+    }
+    ring->mappedSize = (size_t) info.st_size;
+    void *mapping = mmap(0x0, ring->mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return FALSE;
+    }
+    ring->header = (ShmRingHeader *) mapping;
+    if (__atomic_load_n(&ring->header->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC ||
+        sizeof(ShmRingHeader) + ring->header->capacity != ring->mappedSize) {
+        munmap(mapping, ring->mappedSize);
+        errno = EAGAIN;
+        return FALSE;
+    }
+    if (!__atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE) && !processAlive(ring->header->producer)) {
+        munmap(mapping, ring->mappedSize);
+        errno = ESRCH;
+        return FALSE;
+    }
+    uint32_t unclaimed = 0;
+    if (!__atomic_compare_exchange_n(&ring->header->consumer, &unclaimed, (uint32_t) getpid(), FALSE,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) { //Read by an earlier run
+        munmap(mapping, ring->mappedSize);
+        errno = EBUSY;
+        return FALSE;
+    }
+    ring->otherIndex = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+    ring->skipped = 0;
+    ring->record = 0x0;
+    return TRUE;
+}
+
+//Unmaps the ring, the producer marks it closed first. The ring itself stays until shmRingRemove
+void shmRingClose(ShmRing *ring, Bool producer) {
+    if (producer) {
+        __atomic_store_n(&ring->header->closed, 1, __ATOMIC_RELEASE);
+    }
+    munmap(ring->header, ring->mappedSize);
+    ring->header = 0x0;
+}
+
+//Removes the ring called name once both sides are done with it
+void shmRingRemove(const char *name) {
+    shm_unlink(name);
+}
+
+//Returns space for a record of up to maxLength payload bytes to be filled in place, or 0x0 if the ring has no room yet
+//A record that would run past the end of the record space starts again at the beginning, behind a wrap marker
+unsigned char *shmRingReserve(ShmRing *ring, unsigned char type, unsigned int maxLength) {
+    ShmRingHeader *header = ring->header;
+    uint64_t capacity = header->capacity;
+    uint64_t head = header->head;
+    uint64_t offset = head & (capacity - 1);
+    uint64_t size = recordSize(maxLength);
+    uint64_t skipped = size <= capacity - offset ? 0 : capacity - offset;
+    if (maxLength > SHM_RING_MAX_PAYLOAD || skipped + size > capacity) { //Could never fit
+        return 0x0;
+    }
+    if (head + skipped + size - ring->otherIndex > capacity) {
+        ring->otherIndex = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+        if (head + skipped + size - ring->otherIndex > capacity) {
+            header->full++;
+            return 0x0;
+        }
+    }
+    if (skipped > 0) {
+        RecordHeader *marker = (RecordHeader *) &header->records[offset];
+        marker->length = 0;
+        marker->type = 0;
+        marker->wrap = 1;
+        offset = 0;
+    }
+    RecordHeader *record = (RecordHeader *) &header->records[offset];
+    record->type = type;
+    record->wrap = 0;
+    ring->skipped = skipped;
+    ring->record = record;
+    return (unsigned char *) (record + 1);
+}
+
+//Makes the reserved record visible to the consumer with the length of payload actually written, at most maxLength
+//Space reserved past length is given back, so a record can be reserved at its worst case size and encoded in place
+void shmRingCommit(ShmRing *ring, unsigned int length) {
+    RecordHeader *record = (RecordHeader *) ring->record;
+    record->length = (uint16_t) length;
+    uint64_t head = ring->header->head + ring->skipped + recordSize(length);
+    __atomic_store_n(&ring->header->head, head, __ATOMIC_RELEASE);
+    ring->record = 0x0;
+}
+
+//Finds the next record, returns TRUE and fills record if there is one. Call shmRingRelease once done with it
+Bool shmRingNext(ShmRing *ring, ShmRecord *record) {
+    ShmRingHeader *header = ring->header;
+    uint64_t capacity = header->capacity;
+    uint64_t tail = header->tail;
+    if (tail == ring->otherIndex) {
+        ring->otherIndex = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->otherIndex) {
+            return FALSE;
+        }
+    }
+    uint64_t offset = tail & (capacity - 1);
+    uint64_t skipped = 0;
+    const RecordHeader *stored = (const RecordHeader *) &header->records[offset];
+    if (stored->wrap) { //Committed together with the record after it, so that record is there too
+        skipped = capacity - offset;
+        stored = (const RecordHeader *) &header->records[0];
+    }
+    record->type = stored->type;
+    record->length = stored->length;
+    record->payload = (const unsigned char *) (stored + 1);
+    ring->skipped = skipped;
+    ring->record = (void *) stored;
+    return TRUE;
+}
+
+//Frees the ring space of the record returned by shmRingNext
+void shmRingRelease(ShmRing *ring) {
+    const RecordHeader *record = (const RecordHeader *) ring->record;
+    uint64_t tail = ring->header->tail + ring->skipped + recordSize(record->length);
+    __atomic_store_n(&ring->header->tail, tail, __ATOMIC_RELEASE);
+    ring->record = 0x0;
+}
+
+//Returns TRUE once the producer has closed the ring and every record has been read
+Bool shmRingDrained(ShmRing *ring) {
+    if (!__atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE)) {
+        return FALSE;
+    }
+    return ring->header->tail == __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE) ? TRUE : FALSE;
+}
+
+//Returns FALSE if the producer has exited without closing the ring, so no more records will come
+Bool shmRingProducerAlive(ShmRing *ring) {
+    if (__atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE)) {
+        return TRUE;
+    }
+    return processAlive(ring->header->producer);
+}
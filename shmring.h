@@ -0,0 +1,99 @@
+//Single producer single consumer ring of frames in POSIX shared memory, for moving telemetry between host processes
+//A record carries a frame's type and payload with no sync byte or CRC. The producer encodes straight into the
+//shared mapping and the consumer decodes from it in place, so nothing is copied through a pipe
+//Each side only stores its own index, so neither needs a lock
+//A ring is read by one consumer only, which claims it on opening, so a ring left behind by an earlier run that was
+//already read is not read again as an empty stream
+//Host only, the satellite has no shared memory
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Largest payload of one record
+#define SHM_RING_MAX_PAYLOAD 0xFFFF
+
+//Bytes of record space a ring gets when none is asked for
+#define SHM_RING_DEFAULT_CAPACITY (1UL << 22)
+
+//What lives at the start of the shared mapping, the record space follows it
+//The two indexes count bytes ever written and consumed, so they never wrap, and sit on cache lines of their own
+struct ShmRingHeaderStruct {
+    uint32_t magic;
+    uint32_t capacity; //Bytes of record space, a power of two
+    uint32_t closed; //Set by the producer after its last record
+    uint32_t producer; //Process id of the producer, so the consumer can tell when it died without closing the ring
+    uint32_t consumer; //Process id of the consumer that claimed the ring, 0 until one has
+    uint32_t reserved;
+    uint64_t full; //Times the producer found no room, only the producer stores it
+    uint64_t head __attribute__((aligned(64))); //Only the producer stores it
+    uint64_t tail __attribute__((aligned(64))); //Only the consumer stores it
+    unsigned char records[] __attribute__((aligned(64)));
+};
+typedef struct ShmRingHeaderStruct ShmRingHeader;
+
+//One side's view of a ring
+struct ShmRingStruct {
+    ShmRingHeader *header;
+    size_t mappedSize;
+    uint64_t otherIndex; //The other side's index when last read, so the shared cache line is read only when needed
+    uint64_t skipped; //Bytes of wrap marker ahead of the record being written or read
+    void *record; //Header of the record being written or read
+};
+typedef struct ShmRingStruct ShmRing;
+
+//A record still sitting in the ring, read in place until shmRingRelease
+struct ShmRecordStruct {
+    unsigned char type;
+    unsigned int length;
+    const unsigned char *payload;
+};
+typedef struct ShmRecordStruct ShmRecord;
+
+//Creates the ring called name with at least capacity bytes of record space, replacing any old one
+//The record space is a power of two of at least 256KB, so any record fits once the consumer catches up
+//name is a shm_open name such as "/telemetry". Returns FALSE and sets errno on failure
+Bool shmRingCreate(ShmRing *ring, const char *name, unsigned long capacity);
+
+//Opens the ring called name that a producer created and claims it as its consumer
+//Returns FALSE and sets errno if there is none yet, EBUSY if another consumer already claimed it, or ESRCH if its
+//producer died without closing it
+Bool shmRingOpen(ShmRing *ring, const char *name);
+
+//Unmaps the ring, the producer marks it closed first. The ring itself stays until shmRingRemove
+void shmRingClose(ShmRing *ring, Bool producer);
+
+//Removes the ring called name once both sides are done with it
+void shmRingRemove(const char *name);
+
+//Returns space for a record of up to maxLength payload bytes to be filled in place, or 0x0 if the ring has no room yet
+//Every reserve must be followed by shmRingCommit before the next
+unsigned char *shmRingReserve(ShmRing *ring, unsigned char type, unsigned int maxLength);
+
+//Makes the reserved record visible to the consumer with the length of payload actually written, at most maxLength
+void shmRingCommit(ShmRing *ring, unsigned int length);
+
+//Finds the next record, returns TRUE and fills record if there is one. Call shmRingRelease once done with it
+Bool shmRingNext(ShmRing *ring, ShmRecord *record);
+
+//Frees the ring space of the record returned by shmRingNext
+void shmRingRelease(ShmRing *ring);
+
+//Returns TRUE once the producer has closed the ring and every record has been read
+Bool shmRingDrained(ShmRing *ring);
+
+//Returns FALSE if the producer has exited without closing the ring, so no more records will come
+Bool shmRingProducerAlive(ShmRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHMRING_H
@@ -0,0 +1,124 @@
+#include "telemetry.h"
+
+//Writes value as a little endian base 128 varint, returns the new position or -1 if it does not fit
+static int writeVarint(unsigned long value, unsigned char buffer[], int position, int size) {
+    do {
+        if (position >= size) {
+            return -1;
+        }
+        unsigned char byte = (unsigned char) (value & 0x7F);
+        value >>= 7;
+        buffer[position++] = value > 0 ? (unsigned char) (byte | 0x80) : byte;
+    } while (value > 0);
+    return position;
+}
+
+//Reads a varint written by writeVarint, returns the new position or -1 if the buffer ends first
+static int readVarint(const unsigned char buffer[], int position, int length, unsigned long *value) {
+    int shift = 0;
+    *value = 0;
+    while (position < length && shift < 32) {
+        unsigned char byte = buffer[position++];
+        *value |= (unsigned long) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return position;
+        }
+        shift += 7;
+    }
+    return -1;
+}
+
+//Maps small negative and positive deltas to small unsigned numbers, 0 -1 1 -2 2 become 0 1 2 3 4
+static unsigned long zigZag(long delta) {
+    return delta < 0 ? ((unsigned long) (-delta) << 1) - 1 : (unsigned long) delta << 1;
+}
+
+//Reverses zigZag
+static long unZigZag(unsigned long value) {
+    return (value & 1) ? -(long) ((value + 1) >> 1) : (long) (value >> 1);
+}
+
+//Encodes count samples into buffer and returns the number of bytes written, or -1 if buffer is too small
+//Layout: count, then per channel the first value followed by tokens covering the remaining count - 1 deltas
+//A token is zigZag(delta) << 1, with the low bit set when a run length (extra repeats - 1) follows
+int encodeTelemetryBatch(const unsigned short samples[][TELEMETRY_CHANNELS], int count, unsigned char buffer[],
+                         int size) {
+    if (count < 0 || count > TELEMETRY_BATCH_MAX) {
+        return -1;
+    }
+    int position = writeVarint((unsigned long) count, buffer, 0, size);
+    if (count == 0) {
+        return position;
+    }
+    for (int channel = 0; channel < TELEMETRY_CHANNELS && position >= 0; channel++) {
+        position = writeVarint(samples[0][channel], buffer, position, size);
+        int i = 1;
+        while (i < count && position >= 0) {
+            long delta = (long) samples[i][channel] - (long) samples[i - 1][channel];
+            int repeats = 0;
+            while (i + repeats + 1 < count &&
+                   (long) samples[i + repeats + 1][channel] - (long) samples[i + repeats][channel] == delta) {
+                repeats++;
+            }
+            if (repeats > 0) {
+                position = writeVarint(zigZag(delta) << 1 | 1, buffer, position, size);
+                if (position >= 0) {
+                    position = writeVarint((unsigned long) (repeats - 1), buffer, position, size);
+                }
+            } else {
+                position = writeVarint(zigZag(delta) << 1, buffer, position, size);
+            }
+            i += repeats + 1;
+        }
+    }
+    return position;
+}
+
+//Decodes a batch written by encodeTelemetryBatch into samples and returns the number of samples
+//Returns -1 if the batch is malformed or holds more than maxCount samples
+int decodeTelemetryBatch(const unsigned char buffer[], int length, unsigned short samples[][TELEMETRY_CHANNELS],
+                         int maxCount) {
+    unsigned long value;
+    int position = readVarint(buffer, 0, length, &value);
+    if (position < 0 || value > (unsigned long) maxCount || value > TELEMETRY_BATCH_MAX) {
+        return -1;
+    }
+    int count = (int) value;
+    if (count == 0) {
+        return position == length ? 0 : -1;
+    }
+    for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+        position = readVarint(buffer, position, length, &value);
+        if (position < 0 || value > 0xFFFF) {
+            return -1;
+        }
+        samples[0][channel] = (unsigned short) value;
+        int i = 1;
+        while (i < count) {
+            position = readVarint(buffer, position, length, &value);
+            if (position < 0) {
+                return -1;
+            }
+            long delta = unZigZag(value >> 1);
+            unsigned long repeats = 0;
+            if (value & 1) {
+                position = readVarint(buffer, position, length, &repeats);
+                if (position < 0) {
+                    return -1;
+                }
+                repeats++;
+            }
+            if (repeats >= (unsigned long) (count - i)) { //Run would go past the end of the batch
+                return -1;
+            }
+            for (unsigned long r = 0; r <= repeats; r++, i++) {
+                long next = (long) samples[i - 1][channel] + delta;
+                if (next < 0 || next > 0xFFFF) {
+                    return -1;
+                }
+                samples[i][channel] = (unsigned short) next;
+            }
+        }
+    }
+    return position == length ? count : -1;
+}
@@ -0,0 +1,38 @@
+//Telemetry batch encoding shared by the satellite and the ground tools
+//Plain C with no Arduino dependencies so it builds for both
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Values carried by every telemetry sample, in this order
+#define TELEMETRY_CHANNELS 4
+#define TELEMETRY_BATTERY_LEVEL 0
+#define TELEMETRY_FUEL_LEVEL 1
+#define TELEMETRY_POWER_CONSUMPTION 2
+#define TELEMETRY_POWER_GENERATION 3
+
+//Most samples one batch can hold
+#define TELEMETRY_BATCH_MAX 32
+
+//Encoded size of a batch in the worst case, every value a 3 byte varint plus the count
+#define TELEMETRY_BATCH_BUFFER_SIZE (1 + TELEMETRY_CHANNELS * TELEMETRY_BATCH_MAX * 3)
+
+//Encodes count samples into buffer and returns the number of bytes written, or -1 if buffer is too small
+//Each channel is stored as its first value followed by zig-zag deltas, a repeated delta is stored once with a count
+int encodeTelemetryBatch(const unsigned short samples[][TELEMETRY_CHANNELS], int count, unsigned char buffer[],
+                         int size);
+
+//Decodes a batch written by encodeTelemetryBatch into samples and returns the number of samples
+//Returns -1 if the batch is malformed or holds more than maxCount samples
+int decodeTelemetryBatch(const unsigned char buffer[], int length, unsigned short samples[][TELEMETRY_CHANNELS],
+                         int maxCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TELEMETRY_H
@@ -0,0 +1,367 @@
+//Decodes the telemetry frames in a captured serial log and writes columnar summaries of them
+//Usage: telemetry_ingest [-b] [-w samples] [-p period_ms] [-o output] [-t trace] [-m ring_name | capture]
+//  capture     file to read, memory mapped so captures of any size stream through without being loaded.
+//              Standard input is read when it is missing or "-", so a live serial port can be piped in
+//  -w samples  samples summarized per output row (default 1), each row holds min, max and avg of every channel
+//  -p period   milliseconds between samples, the satellite's runDelay (default 5000)
+//  -b          write binary column blocks instead of CSV
+//  -o output   file to write instead of standard output
+//  -t trace    also write the scheduler trace frames of a USE_TRACE build to this file as Chrome trace JSON
+//  -m name     read the shared memory ring a telemetry_sim -m producer writes, until it closes the ring.
+//              Records are decoded in place, with no framing, CRC or pipe copy on the way. A ring an earlier run
+//              already read is waited past, and a producer that dies without closing the ring ends the read
+//              with an error
+//Console text and damaged frames in the capture are skipped
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "frame.h"
+#include "telemetry.h"
+#include "crc.h"
+#include "trace.h"
+#include "shmring.h"
+
+//Rows buffered before a binary column block is written
+#define BLOCK_ROWS 4096
+//Bytes read at a time from a pipe
+#define READ_SIZE (1 << 20)
+//Seconds to wait for a producer to create the shared memory ring
+#define RING_OPEN_WAIT 10
+
+static const char *channelNames[TELEMETRY_CHANNELS] = {"battery", "fuel", "consumption", "generation"};
+//In the order setupSystem queues the tasks
+static const char *const taskNames[] = {"powerSubsystemTask", "thrusterSubsystemTask", "satelliteComsTask",
+                                        "consoleDisplayTask", "warningAlarmTask", "dashboardDisplayTask"};
+
+//Summary of one output row, kept column by column so a block can be written one column at a time
+struct ColumnsStruct {
+    unsigned long long time[BLOCK_ROWS];
+    unsigned short min[TELEMETRY_CHANNELS][BLOCK_ROWS];
+    unsigned short max[TELEMETRY_CHANNELS][BLOCK_ROWS];
+    unsigned short avg[TELEMETRY_CHANNELS][BLOCK_ROWS];
+    unsigned int rows;
+};
+typedef struct ColumnsStruct Columns;
+
+//Everything the decoder carries from one frame to the next
+struct IngestStruct {
+    FILE *out;
+    int binary;
+    unsigned long window;
+    unsigned long period;
+    unsigned long long samples; //Samples decoded so far, sample n was taken at n * period
+    unsigned long inWindow;
+    unsigned long min[TELEMETRY_CHANNELS];
+    unsigned long max[TELEMETRY_CHANNELS];
+    unsigned long long sum[TELEMETRY_CHANNELS];
+    unsigned long long badBatches;
+    FILE *traceOut; //NULL when trace frames are skipped
+    ChromeTrace trace;
+    FrameScanStats stats;
+    Columns columns;
+};
+typedef struct IngestStruct Ingest;
+
+//Writes the buffered rows, as CSV lines or as one binary block of row count then each column in turn
+void flushRows(Ingest *ingest) {
+    Columns *columns = &ingest->columns;
+    if (columns->rows == 0) {
+        return;
+    }
+    if (ingest->binary) {
+        unsigned int rows = columns->rows;
+        fwrite(&rows, sizeof(rows), 1, ingest->out);
+        fwrite(columns->time, sizeof(columns->time[0]), rows, ingest->out);
+        for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+            fwrite(columns->min[channel], sizeof(unsigned short), rows, ingest->out);
+            fwrite(columns->max[channel], sizeof(unsigned short), rows, ingest->out);
+            fwrite(columns->avg[channel], sizeof(unsigned short), rows, ingest->out);
+        }
+    } else {
+        for (unsigned int row = 0; row < columns->rows; row++) {
+            fprintf(ingest->out, "%llu", columns->time[row]);
+            for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+                fprintf(ingest->out, ",%u,%u,%u", columns->min[channel][row], columns->max[channel][row],
+                        columns->avg[channel][row]);
+            }
+            fputc('\n', ingest->out);
+        }
+    }
+    columns->rows = 0;
+}
+
+//Closes the current window into a row
+void closeWindow(Ingest *ingest) {
+    if (ingest->inWindow == 0) {
+        return;
+    }
+    Columns *columns = &ingest->columns;
+    unsigned int row = columns->rows;
+    columns->time[row] = (ingest->samples - ingest->inWindow) * ingest->period;
+    for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+        columns->min[channel][row] = (unsigned short) ingest->min[channel];
+        columns->max[channel][row] = (unsigned short) ingest->max[channel];
+        columns->avg[channel][row] = (unsigned short) (ingest->sum[channel] / ingest->inWindow);
+        ingest->min[channel] = 0xFFFF;
+        ingest->max[channel] = 0;
+        ingest->sum[channel] = 0;
+    }
+    ingest->inWindow = 0;
+    if (++columns->rows == BLOCK_ROWS) {
+        flushRows(ingest);
+    }
+}
+
+//Adds one decoded sample to the current window
+void addSample(Ingest *ingest, const unsigned short sample[TELEMETRY_CHANNELS]) {
+    for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+        if (sample[channel] < ingest->min[channel]) ingest->min[channel] = sample[channel];
+        if (sample[channel] > ingest->max[channel]) ingest->max[channel] = sample[channel];
+        ingest->sum[channel] += sample[channel];
+    }
+    ingest->samples++;
+    if (++ingest->inWindow == ingest->window) {
+        closeWindow(ingest);
+    }
+}
+
+//Decodes one frame's payload, wherever it was found
+void ingestFrame(Ingest *ingest, unsigned char type, const unsigned char payload[], unsigned int length) {
+    unsigned short samples[TELEMETRY_BATCH_MAX][TELEMETRY_CHANNELS];
+    if (type == FRAME_TRACE && ingest->traceOut != NULL) {
+        TraceEvent event;
+        for (unsigned int i = 0; i + TRACE_EVENT_SIZE <= length; i += TRACE_EVENT_SIZE) {
+            unpackTraceEvent(payload + i, &event);
+            writeChromeTraceEvent(&ingest->trace, &event);
+        }
+        return;
+    }
+    if (type != FRAME_TELEMETRY_BATCH) {
+        return;
+    }
+    int count = decodeTelemetryBatch(payload, (int) length, samples, TELEMETRY_BATCH_MAX);
+    if (count < 0) {
+        ingest->badBatches++;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        addSample(ingest, samples[i]);
+    }
+}
+
+//Decodes every complete frame in buffer and returns how many leading bytes are finished with
+unsigned long ingestBuffer(Ingest *ingest, const unsigned char buffer[], unsigned long length) {
+    unsigned long position = 0;
+    FrameSpan frame;
+    while (frameScan(buffer, length, &position, &frame, &ingest->stats)) {
+        ingestFrame(ingest, frame.type, frame.payload, frame.length);
+    }
+    return position;
+}
+
+//Streams a pipe through the decoder, keeping only a partial frame between reads
+int ingestStream(Ingest *ingest, int fd) {
+    unsigned char *buffer = malloc(READ_SIZE + FRAME_OVERHEAD + 0xFF);
+    if (buffer == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    unsigned long kept = 0;
+    ssize_t got;
+    while ((got = read(fd, buffer + kept, READ_SIZE)) > 0) {
+        unsigned long length = kept + (unsigned long) got;
+        unsigned long used = ingestBuffer(ingest, buffer, length);
+        kept = length - used;
+        memmove(buffer, buffer + used, kept);
+    }
+    ingest->stats.droppedBytes += kept;
+    free(buffer);
+    if (got < 0) {
+        perror("read");
+        return 1;
+    }
+    return 0;
+}
+
+//Maps a capture file and runs it through the decoder in one pass
+int ingestFile(Ingest *ingest, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        perror(path);
+        close(fd);
+        return 1;
+    }
+    if (!S_ISREG(info.st_mode) || info.st_size == 0) { //Pipes, devices and empty files cannot be mapped
+        int result = ingestStream(ingest, fd);
+        close(fd);
+        return result;
+    }
+    unsigned char *capture = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (capture == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise(capture, (size_t) info.st_size, MADV_SEQUENTIAL);
+    unsigned long used = ingestBuffer(ingest, capture, (unsigned long) info.st_size);
+    ingest->stats.droppedBytes += (unsigned long) info.st_size - used;
+    munmap(capture, (size_t) info.st_size);
+    return 0;
+}
+
+//Decodes the records of a shared memory ring in place until the producer closes it or dies, then removes the ring
+int ingestRing(Ingest *ingest, const char *name) {
+    ShmRing ring;
+    int tries = 0;
+    //The producer may not have created it yet, or not yet replaced one an earlier run left behind
+    while (!shmRingOpen(&ring, name)) {
+        if (++tries > RING_OPEN_WAIT * 100) {
+            if (errno == EBUSY) {
+                fprintf(stderr, "%s: only an already read ring from an earlier run\n", name);
+            } else if (errno == ESRCH) {
+                fprintf(stderr, "%s: only a ring whose producer died without closing it\n", name);
+            } else {
+                perror(name);
+            }
+            return 1;
+        }
+        usleep(10000);
+    }
+    ShmRecord record;
+    unsigned long idle = 0;
+    Bool abandoned = FALSE;
+    int result = 0;
+    while (1) {
+        if (shmRingNext(&ring, &record)) {
+            ingestFrame(ingest, record.type, record.payload, record.length);
+            shmRingRelease(&ring);
+            ingest->stats.frames++;
+            idle = 0;
+        } else if (shmRingDrained(&ring)) {
+            break;
+        } else if (abandoned) { //Everything it committed before it died has been read
+            fprintf(stderr, "%s: the producer died without closing the ring\n", name);
+            result = 1;
+            break;
+        } else if (++idle > 64) { //Spin briefly, then stop holding the core the producer may need
+            if (idle % 1024 == 0 && !shmRingProducerAlive(&ring)) {
+                abandoned = TRUE;
+            }
+            sched_yield();
+        }
+    }
+    shmRingClose(&ring, FALSE);
+    shmRingRemove(name);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    static Ingest ingest;
+    ingest.out = stdout;
+    ingest.window = 1;
+    ingest.period = 5000;
+    for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+        ingest.min[channel] = 0xFFFF;
+    }
+    const char *outputPath = NULL;
+    const char *tracePath = NULL;
+    const char *ringName = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "bw:p:o:t:m:")) != -1) {
+        switch (option) {
+            case 'b':
+                ingest.binary = 1;
+                break;
+            case 'w':
+                ingest.window = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                ingest.period = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            case 't':
+                tracePath = optarg;
+                break;
+            case 'm':
+                ringName = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b] [-w samples] [-p period_ms] [-o output] [-t trace]"
+                                " [-m ring_name | capture]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (ingest.window == 0) {
+        fprintf(stderr, "-w must be at least 1\n");
+        return 1;
+    }
+    if (!crcSelfTest()) {
+        fprintf(stderr, "CRC self test failed\n");
+        return 1;
+    }
+    if (outputPath != NULL) {
+        ingest.out = fopen(outputPath, ingest.binary ? "wb" : "w");
+        if (ingest.out == NULL) {
+            perror(outputPath);
+            return 1;
+        }
+    }
+    if (tracePath != NULL) {
+        ingest.traceOut = fopen(tracePath, "w");
+        if (ingest.traceOut == NULL) {
+            perror(tracePath);
+            return 1;
+        }
+        beginChromeTrace(&ingest.trace, ingest.traceOut, taskNames, sizeof(taskNames) / sizeof(taskNames[0]));
+    }
+    static char outputBuffer[1 << 16];
+    setvbuf(ingest.out, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    if (!ingest.binary) {
+        fprintf(ingest.out, "time_ms");
+        for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+            fprintf(ingest.out, ",%s_min,%s_max,%s_avg", channelNames[channel], channelNames[channel],
+                    channelNames[channel]);
+        }
+        fputc('\n', ingest.out);
+    }
+
+    int result;
+    if (ringName != NULL) {
+        result = ingestRing(&ingest, ringName);
+    } else if (optind >= argc || strcmp(argv[optind], "-") == 0) {
+        result = ingestStream(&ingest, STDIN_FILENO);
+    } else {
+        result = ingestFile(&ingest, argv[optind]);
+    }
+    closeWindow(&ingest); //A partial last window still gets its row
+    flushRows(&ingest);
+    if (ingest.traceOut != NULL) {
+        endChromeTrace(&ingest.trace);
+        fclose(ingest.traceOut);
+    }
+    if (ingest.out != stdout) {
+        fclose(ingest.out);
+    } else {
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "frames %llu samples %llu skipped bytes %llu crc errors %llu bad batches %llu\n",
+            ingest.stats.frames, ingest.samples, ingest.stats.droppedBytes, ingest.stats.crcErrors,
+            ingest.badBatches);
+    return result;
+}
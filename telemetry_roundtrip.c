@@ -0,0 +1,155 @@
+//Checks that telemetry batches decode back to exactly the samples they were encoded from
+//Covers every batch size from 0 to TELEMETRY_BATCH_MAX with runs of repeated deltas, jumps between 0 and 0xFFFF
+//and random values, then random batches. Every batch is also encoded into every buffer too small for it, which must
+//fail without writing past the end, and decoded from every truncation of itself, which must be rejected
+//Usage: telemetry_roundtrip [-n random_batches] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "telemetry.h"
+
+//Bytes past the end of an encode buffer that must stay untouched
+#define GUARD_SIZE 8
+#define GUARD_BYTE 0xA5
+
+//Sample patterns each batch size is checked with
+enum PatternStruct {
+    PATTERN_CONSTANT, //One run of zero deltas
+    PATTERN_RAMP, //One run of a nonzero delta
+    PATTERN_EXTREMES, //0 and 0xFFFF alternating, the largest deltas both ways
+    PATTERN_RUNS_THEN_JUMP, //Runs of zero deltas broken by jumps across the whole range
+    PATTERN_SMALL_STEPS, //Random deltas of a few units, like the real levels
+    PATTERN_RANDOM, //Random values over the whole range
+    PATTERN_COUNT
+};
+typedef enum PatternStruct Pattern;
+
+//What the checks found
+struct RoundTripStatsStruct {
+    unsigned long batches;
+    unsigned long bytes;
+    unsigned long failures;
+};
+typedef struct RoundTripStatsStruct RoundTripStats;
+
+//Returns the next 16 bits of a small generator
+unsigned short nextRandom(unsigned long *state) {
+    *state = *state * 1103515245UL + 12345UL;
+    unsigned short high = (unsigned short) ((*state >> 16) & 0xFF);
+    *state = *state * 1103515245UL + 12345UL;
+    return (unsigned short) (high << 8 | ((*state >> 16) & 0xFF));
+}
+
+//Fills count samples of every channel with a pattern
+void fillSamples(unsigned short samples[][TELEMETRY_CHANNELS], int count, Pattern pattern, unsigned long *state) {
+    for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+        unsigned short value = nextRandom(state);
+        for (int i = 0; i < count; i++) {
+            switch (pattern) {
+                case PATTERN_CONSTANT:
+                    break;
+                case PATTERN_RAMP:
+                    value = (unsigned short) (channel * 1000 + i * (channel + 1));
+                    break;
+                case PATTERN_EXTREMES:
+                    value = (i + channel) % 2 ? 0xFFFF : 0;
+                    break;
+                case PATTERN_RUNS_THEN_JUMP:
+                    if (i % 5 == 0) {
+                        value = value < 0x8000 ? 0xFFFF : 0;
+                    }
+                    break;
+                case PATTERN_SMALL_STEPS:
+                    value = (unsigned short) (value + nextRandom(state) % 7 - 3);
+                    break;
+                default:
+                    value = nextRandom(state);
+                    break;
+            }
+            samples[i][channel] = value;
+        }
+    }
+}
+
+//Encodes and decodes one batch every way there is and counts what went wrong
+void checkBatch(const unsigned short samples[][TELEMETRY_CHANNELS], int count, RoundTripStats *stats) {
+    unsigned char buffer[TELEMETRY_BATCH_BUFFER_SIZE + GUARD_SIZE];
+    unsigned short decoded[TELEMETRY_BATCH_MAX][TELEMETRY_CHANNELS];
+    stats->batches++;
+    int length = encodeTelemetryBatch(samples, count, buffer, TELEMETRY_BATCH_BUFFER_SIZE);
+    if (length < 0) {
+        fprintf(stderr, "%d samples: did not fit the worst case buffer\n", count);
+        stats->failures++;
+        return;
+    }
+    stats->bytes += (unsigned long) length;
+
+    if (decodeTelemetryBatch(buffer, length, decoded, TELEMETRY_BATCH_MAX) != count ||
+        memcmp(decoded, samples, (size_t) count * sizeof(decoded[0])) != 0) {
+        fprintf(stderr, "%d samples: decoded differently from what was encoded\n", count);
+        stats->failures++;
+    }
+    if (count > 0 && decodeTelemetryBatch(buffer, length, decoded, count - 1) != -1) {
+        fprintf(stderr, "%d samples: decoded into room for %d\n", count, count - 1);
+        stats->failures++;
+    }
+    for (int truncated = 0; truncated < length; truncated++) {
+        if (decodeTelemetryBatch(buffer, truncated, decoded, TELEMETRY_BATCH_MAX) != -1) {
+            fprintf(stderr, "%d samples: decoded from %d of its %d bytes\n", count, truncated, length);
+            stats->failures++;
+        }
+    }
+    for (int size = 0; size < length; size++) {
+        memset(buffer, GUARD_BYTE, sizeof(buffer));
+        int result = encodeTelemetryBatch(samples, count, buffer, size);
+        int guardIntact = 1;
+        for (int i = size; i < size + GUARD_SIZE; i++) {
+            if (buffer[i] != GUARD_BYTE) {
+                guardIntact = 0;
+            }
+        }
+        if (result != -1 || !guardIntact) {
+            fprintf(stderr, "%d samples: encoding into %d of the %d bytes needed %s\n", count, size, length,
+                    result != -1 ? "did not fail" : "wrote past the end");
+            stats->failures++;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long randomBatches = 10000;
+    unsigned long state = 1000;
+    int option;
+    while ((option = getopt(argc, argv, "n:s:")) != -1) {
+        switch (option) {
+            case 'n':
+                randomBatches = atol(optarg);
+                break;
+            case 's':
+                state = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n random_batches] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    RoundTripStats stats = {0, 0, 0};
+    unsigned short samples[TELEMETRY_BATCH_MAX][TELEMETRY_CHANNELS];
+    for (int count = 0; count <= TELEMETRY_BATCH_MAX; count++) {
+        for (int pattern = 0; pattern < PATTERN_COUNT; pattern++) {
+            fillSamples(samples, count, (Pattern) pattern, &state);
+            checkBatch(samples, count, &stats);
+        }
+    }
+    for (long i = 0; i < randomBatches; i++) {
+        int count = 1 + nextRandom(&state) % TELEMETRY_BATCH_MAX;
+        fillSamples(samples, count, (Pattern) (nextRandom(&state) % PATTERN_COUNT), &state);
+        checkBatch(samples, count, &stats);
+    }
+
+    printf("%lu batches, %lu encoded bytes, %lu failures\n", stats.batches, stats.bytes, stats.failures);
+    return stats.failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+//Flies the mission model faster than real time and sends its telemetry batches the way satelliteComsTask does,
+//for feeding the ground tools with fleet sized volumes of data
+//Usage: telemetry_sim [-n missions] [-s first_seed] [-l periods] [-b batch_samples] [-m ring_name] [-z ring_bytes]
+//  -n missions  missions flown one after another, each from its own seed (default 1)
+//  -l periods   periods a mission is flown for unless the fuel runs out first (default 100000)
+//  -b samples   samples per telemetry batch, the satellite's TELEMETRY_BATCH_SAMPLES (default 8)
+//  -m name      write the batches to the shared memory ring called name, for telemetry_ingest -m
+//               Without it the batches go to standard output as frames, byte for byte what the serial link carries
+//  -z bytes     record space of the shared memory ring, rounded up to a power of two of at least 256KB
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "mission.h"
+#include "telemetry.h"
+#include "frame.h"
+#include "crc.h"
+#include "shmring.h"
+#include "hosttools.h"
+
+//Where the batches go
+struct SinkStruct {
+    ShmRing ring;
+    Bool toRing; //Otherwise frames to standard output
+    unsigned long long batches;
+    unsigned long long bytes; //Payload bytes, plus framing on standard output
+    unsigned long long waits; //Times the ring was full and the simulator waited for the consumer
+};
+typedef struct SinkStruct Sink;
+
+//Encodes a batch and sends it, into the ring in place or to standard output as a frame
+//A full ring is waited on rather than dropped, so the consumer sees every batch
+void sendBatch(Sink *sink, unsigned short samples[][TELEMETRY_CHANNELS], int count) {
+    int length;
+    if (sink->toRing) {
+        unsigned int size = 1 + TELEMETRY_CHANNELS * count * 3; //Worst case, every value a 3 byte varint
+        unsigned char *payload;
+        while ((payload = shmRingReserve(&sink->ring, FRAME_TELEMETRY_BATCH, size)) == NULL) {
+            sink->waits++;
+            sched_yield();
+        }
+        length = encodeTelemetryBatch(samples, count, payload, (int) size);
+        shmRingCommit(&sink->ring, length < 0 ? 0 : (unsigned int) length);
+    } else {
+        unsigned char buffer[TELEMETRY_BATCH_BUFFER_SIZE];
+        length = encodeTelemetryBatch(samples, count, buffer, sizeof(buffer));
+        if (length < 0 || length > 0xFF) { //Too big for a serial frame, as on the satellite
+            return;
+        }
+        writeFrame(stdout, FRAME_TELEMETRY_BATCH, buffer, (unsigned char) length);
+        length += FRAME_OVERHEAD;
+    }
+    sink->batches++;
+    sink->bytes += (unsigned long long) length;
+}
+
+//Flies one mission and sends a sample of it every period, returns the number of samples
+unsigned long flyMission(Sink *sink, int32_t seed, unsigned long periods, int batchSamples) {
+    unsigned short batch[TELEMETRY_BATCH_MAX][TELEMETRY_CHANNELS];
+    int batchCount = 0;
+    MissionState mission;
+    initMission(&mission, seed);
+    while (mission.periods < periods && mission.fuelLevel > 0) {
+        stepMission(&mission);
+        unsigned short *sample = batch[batchCount];
+        sample[TELEMETRY_BATTERY_LEVEL] = mission.batteryLevel;
+        sample[TELEMETRY_FUEL_LEVEL] = mission.fuelLevel;
+        sample[TELEMETRY_POWER_CONSUMPTION] = mission.powerConsumption;
+        sample[TELEMETRY_POWER_GENERATION] = mission.powerGeneration;
+        if (++batchCount == batchSamples) {
+            sendBatch(sink, batch, batchCount);
+            batchCount = 0;
+        }
+    }
+    if (batchCount > 0) {
+        sendBatch(sink, batch, batchCount);
+    }
+    return mission.periods;
+}
+
+int main(int argc, char *argv[]) {
+    long missions = 1;
+    long firstSeed = 1000;
+    unsigned long periods = 100000;
+    int batchSamples = 8;
+    const char *ringName = NULL;
+    unsigned long ringBytes = SHM_RING_DEFAULT_CAPACITY;
+    int option;
+    while ((option = getopt(argc, argv, "n:s:l:b:m:z:")) != -1) {
+        switch (option) {
+            case 'n':
+                missions = atol(optarg);
+                break;
+            case 's':
+                firstSeed = atol(optarg);
+                break;
+            case 'l':
+                periods = strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                batchSamples = atoi(optarg);
+                break;
+            case 'm':
+                ringName = optarg;
+                break;
+            case 'z':
+                ringBytes = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n missions] [-s first_seed] [-l periods] [-b batch_samples]"
+                                " [-m ring_name] [-z ring_bytes]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (batchSamples < 1 || batchSamples > TELEMETRY_BATCH_MAX) {
+        fprintf(stderr, "-b takes 1 to %d samples\n", TELEMETRY_BATCH_MAX);
+        return 1;
+    }
+    if (!crcSelfTest()) {
+        fprintf(stderr, "CRC self test failed\n");
+        return 1;
+    }
+    static Sink sink;
+    if (ringName != NULL) {
+        if (!shmRingCreate(&sink.ring, ringName, ringBytes)) {
+            perror(ringName);
+            return 1;
+        }
+        sink.toRing = TRUE;
+    } else {
+        static char outputBuffer[1 << 16];
+        setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    }
+
+    unsigned long long samples = 0;
+    double start = seconds();
+    for (long i = 0; i < missions; i++) {
+        samples += flyMission(&sink, (int32_t) (firstSeed + i), periods, batchSamples);
+    }
+    if (sink.toRing) {
+        shmRingClose(&sink.ring, TRUE);
+    } else {
+        fflush(stdout);
+    }
+    double elapsed = seconds() - start;
+
+    fprintf(stderr, "missions %ld samples %llu batches %llu bytes %llu", missions, samples, sink.batches, sink.bytes);
+    if (sink.toRing) {
+        fprintf(stderr, " ring full waits %llu", sink.waits);
+    }
+    fprintf(stderr, " in %.3f s, %.1f M samples/s\n", elapsed, elapsed > 0 ? samples / elapsed / 1e6 : 0.0);
+    return 0;
+}
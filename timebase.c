@@ -0,0 +1,17 @@
+#include "timebase.h"
+
+//Starts counting wraps from tick
+void initTimeBase(TimeBase *base, uint32_t tick) {
+    base->lastTick = tick;
+    base->wraps = 0;
+}
+
+//Returns tick extended to 64 bits. It must be called at least once per wrap of the tick, with ticks in order
+//A tick below the last one means the counter wrapped in between
+uint64_t extendTime(TimeBase *base, uint32_t tick) {
+    if (tick < base->lastTick) {
+        base->wraps++;
+    }
+    base->lastTick = tick;
+    return ((uint64_t) base->wraps << 32) | tick;
+}
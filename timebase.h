@@ -0,0 +1,46 @@
+//Millisecond time that keeps working past the wrap of the 32 bit millis() counter, about 49.7 days after power on
+//Deadlines stay 32 bit and are compared through their difference, which is right while the two times are less
+//than about 24.8 days apart. The 64 bit extended tick is for uptime and anything else that must never wrap
+//Plain C with no Arduino dependencies
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+#include "satellite_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//A start for millis() one minute short of its wrap, to exercise the wrap without waiting for it
+#define TIME_NEAR_WRAP (0xFFFFFFFFUL - 60000UL)
+
+//Returns TRUE once now has reached deadline
+static inline Bool timeReached(uint32_t now, uint32_t deadline) {
+    return (int32_t) (now - deadline) >= 0 ? TRUE : FALSE;
+}
+
+//Returns TRUE if time a comes before time b
+static inline Bool timeBefore(uint32_t a, uint32_t b) {
+    return (int32_t) (a - b) < 0 ? TRUE : FALSE;
+}
+
+//Extends a 32 bit tick to 64 bits by counting its wraps
+struct TimeBaseStruct {
+    uint32_t lastTick;
+    uint32_t wraps;
+};
+typedef struct TimeBaseStruct TimeBase;
+
+//Starts counting wraps from tick
+void initTimeBase(TimeBase *base, uint32_t tick);
+
+//Returns tick extended to 64 bits. It must be called at least once per wrap of the tick, with ticks in order
+uint64_t extendTime(TimeBase *base, uint32_t tick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TIMEBASE_H
@@ -0,0 +1,120 @@
+#include "trace.h"
+
+//Empties the buffer, the clock is kept
+void clearTrace(TraceBuffer *buffer) {
+    buffer->count = 0;
+}
+
+//Adds one event if there is room
+static void appendTrace(TraceBuffer *buffer, uint32_t time, unsigned char type, unsigned char arg) {
+    if (buffer->count >= TRACE_BUFFER_EVENTS) {
+        return;
+    }
+    TraceEvent *event = &buffer->events[buffer->count++];
+    event->time = time;
+    event->type = type;
+    event->arg = arg;
+}
+
+//Records one event unless the buffer is full, with a TRACE_CLOCK_JUMP ahead of it if the clock went backwards
+void recordTrace(TraceBuffer *buffer, uint32_t time, unsigned char type, unsigned char arg) {
+    if (time < buffer->lastTime) {
+        appendTrace(buffer, time, TRACE_CLOCK_JUMP, 0);
+    }
+    buffer->lastTime = time;
+    appendTrace(buffer, time, type, arg);
+}
+
+//Returns TRUE once the buffer has no room left
+Bool traceFull(const TraceBuffer *buffer) {
+    return buffer->count >= TRACE_BUFFER_EVENTS ? TRUE : FALSE;
+}
+
+//Packs count events into out, which must hold count * TRACE_EVENT_SIZE bytes
+void packTraceEvents(const TraceEvent events[], unsigned int count, unsigned char out[]) {
+    for (unsigned int i = 0; i < count; i++) {
+        uint32_t time = events[i].time;
+        out[0] = (unsigned char) (time >> 24);
+        out[1] = (unsigned char) (time >> 16);
+        out[2] = (unsigned char) (time >> 8);
+        out[3] = (unsigned char) time;
+        out[4] = events[i].type;
+        out[5] = events[i].arg;
+        out += TRACE_EVENT_SIZE;
+    }
+}
+
+//Unpacks one event packed by packTraceEvents
+void unpackTraceEvent(const unsigned char in[], TraceEvent *event) {
+    event->time = ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 8) | in[3];
+    event->type = in[4];
+    event->arg = in[5];
+}
+
+#ifndef __AVR__
+//Starts a trace on out, tasks are named from taskNames by slot and by number past its end
+void beginChromeTrace(ChromeTrace *trace, FILE *out, const char *const taskNames[], unsigned int taskNameCount) {
+    trace->out = out;
+    trace->taskNames = taskNames;
+    trace->taskNameCount = taskNameCount;
+    trace->offset = 0;
+    trace->lastTime = 0;
+    trace->events = 0;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+}
+
+//Writes the fields every event shares, ph is the Chrome phase
+static void writeEventHead(ChromeTrace *trace, const char *phase, uint64_t time) {
+    fprintf(trace->out, "%s{\"ph\":\"%s\",\"ts\":%llu,\"pid\":1,\"tid\":1", trace->events > 0 ? ",\n" : "", phase,
+            (unsigned long long) time);
+    trace->events++;
+}
+
+//Writes one event to the trace
+//Task and idle spans become begin and end pairs, everything else an instant event
+void writeChromeTraceEvent(ChromeTrace *trace, const TraceEvent *event) {
+    if (event->time < trace->lastTime) { //Wrapped, or the jump event itself was lost
+        trace->offset += (uint64_t) 1 << 32;
+    }
+    trace->lastTime = event->time;
+    uint64_t time = trace->offset + event->time;
+    switch (event->type) {
+        case TRACE_TASK_BEGIN:
+        case TRACE_TASK_END:
+            writeEventHead(trace, event->type == TRACE_TASK_BEGIN ? "B" : "E", time);
+            if (event->arg < trace->taskNameCount) {
+                fprintf(trace->out, ",\"name\":\"%s\",\"cat\":\"task\"}", trace->taskNames[event->arg]);
+            } else {
+                fprintf(trace->out, ",\"name\":\"task %u\",\"cat\":\"task\"}", event->arg);
+            }
+            break;
+        case TRACE_IDLE_BEGIN:
+        case TRACE_IDLE_END:
+            writeEventHead(trace, event->type == TRACE_IDLE_BEGIN ? "B" : "E", time);
+            fputs(",\"name\":\"idle\",\"cat\":\"idle\"}", trace->out);
+            break;
+        case TRACE_SERIAL_WRITE:
+            writeEventHead(trace, "i", time);
+            fprintf(trace->out, ",\"name\":\"serial write\",\"cat\":\"io\",\"s\":\"t\",\"args\":{\"bytes\":%u}}",
+                    event->arg);
+            break;
+        case TRACE_LCD_DRAW:
+            writeEventHead(trace, "i", time);
+            fprintf(trace->out, ",\"name\":\"lcd draw\",\"cat\":\"io\",\"s\":\"t\",\"args\":{\"id\":%u}}", event->arg);
+            break;
+        case TRACE_CLOCK_JUMP:
+            writeEventHead(trace, "i", time);
+            fputs(",\"name\":\"clock jump\",\"cat\":\"clock\",\"s\":\"g\"}", trace->out);
+            break;
+        default:
+            writeEventHead(trace, "i", time);
+            fprintf(trace->out, ",\"name\":\"unknown %u\",\"s\":\"t\"}", event->type);
+            break;
+    }
+}
+
+//Closes the JSON of the trace
+void endChromeTrace(ChromeTrace *trace) {
+    fputs("\n]}\n", trace->out);
+}
+#endif
@@ -0,0 +1,93 @@
+//Compact timeline of scheduler events, recorded on the satellite and turned into Chrome trace JSON on the ground
+//The JSON loads in chrome://tracing and in the Perfetto UI
+//Plain C with no Arduino dependencies, the JSON writer is only built for the host
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "satellite_types.h"
+
+#ifndef __AVR__
+#include <stdio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Event types
+#define TRACE_TASK_BEGIN 1 //arg is the task's slot in the task queue
+#define TRACE_TASK_END 2
+#define TRACE_IDLE_BEGIN 3
+#define TRACE_IDLE_END 4
+#define TRACE_SERIAL_WRITE 5 //arg is the bytes written, 255 for 255 or more
+#define TRACE_LCD_DRAW 6 //arg is the string id of the label or gauge drawn
+#define TRACE_CLOCK_JUMP 7 //The microsecond clock went backwards, it wrapped or the satellite reset
+
+//Bytes of one packed event, the time in microseconds high byte first, then type and arg
+#define TRACE_EVENT_SIZE 6
+
+//Events the satellite buffers before it has to send them, 6 bytes of RAM each
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 40
+#endif
+
+struct TraceEventStruct {
+    uint32_t time; //Microseconds, wraps every 71 minutes
+    unsigned char type;
+    unsigned char arg;
+};
+typedef struct TraceEventStruct TraceEvent;
+
+//Events recorded since the buffer was last cleared. Recording stops when it fills, so what is sent is an unbroken
+//window of the timeline and the gap until the next window shows where the buffer was being sent
+struct TraceBufferStruct {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    unsigned char count;
+    uint32_t lastTime;
+};
+typedef struct TraceBufferStruct TraceBuffer;
+
+//Empties the buffer, the clock is kept
+void clearTrace(TraceBuffer *buffer);
+
+//Records one event unless the buffer is full, with a TRACE_CLOCK_JUMP ahead of it if the clock went backwards
+void recordTrace(TraceBuffer *buffer, uint32_t time, unsigned char type, unsigned char arg);
+
+//Returns TRUE once the buffer has no room left
+Bool traceFull(const TraceBuffer *buffer);
+
+//Packs count events into out, which must hold count * TRACE_EVENT_SIZE bytes
+void packTraceEvents(const TraceEvent events[], unsigned int count, unsigned char out[]);
+
+//Unpacks one event packed by packTraceEvents
+void unpackTraceEvent(const unsigned char in[], TraceEvent *event);
+
+#ifndef __AVR__
+//Chrome trace JSON being written, times are unwrapped into one 64 bit timeline as they arrive
+struct ChromeTraceStruct {
+    FILE *out;
+    const char *const *taskNames;
+    unsigned int taskNameCount;
+    uint64_t offset; //Added to every time, grows by 2^32 each time the clock goes backwards
+    uint32_t lastTime;
+    unsigned long events; //Events written so far
+};
+typedef struct ChromeTraceStruct ChromeTrace;
+
+//Starts a trace on out, tasks are named from taskNames by slot and by number past its end
+void beginChromeTrace(ChromeTrace *trace, FILE *out, const char *const taskNames[], unsigned int taskNameCount);
+
+//Writes one event to the trace
+void writeChromeTraceEvent(ChromeTrace *trace, const TraceEvent *event);
+
+//Closes the JSON of the trace
+void endChromeTrace(ChromeTrace *trace);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TRACE_H
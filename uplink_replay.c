@@ -0,0 +1,123 @@
+//Feeds a captured or generated uplink byte stream through the satellite's frame parser and reports throughput
+//Usage: uplink_replay [file]        parses file, or standard input when no file is given
+//       uplink_replay -g <frames>   writes a synthetic stream of frames with line noise to standard output
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+#include "crc.h"
+#include "hosttools.h"
+
+//Bytes read from the input at a time, the ring is fed from this the way the serial port would feed it
+#define READ_CHUNK 4096
+
+//What the parsed frames held
+struct ReplayCountsStruct {
+    unsigned long thrustCommands;
+    unsigned long modeChanges;
+    unsigned long otherFrames; //Unknown types and commands with the wrong payload length, which the satellite ignores
+    unsigned long checksum; //Keeps the payload reads from being optimized away
+};
+typedef struct ReplayCountsStruct ReplayCounts;
+
+//Writes count random thrust and mode frames to out, with a noise byte or a damaged frame now and then
+void generate(FILE *out, long count) {
+    srand(1000);
+    unsigned char payload[2];
+    for (long i = 0; i < count; i++) {
+        if (rand() % 16 == 0) {
+            fputc(rand() & 0xFF, out);
+        }
+        if (rand() % 2 == 0) {
+            unsigned int signal = (unsigned int) rand() & 0xFFFF;
+            payload[0] = (unsigned char) (signal >> 8);
+            payload[1] = (unsigned char) (signal & 0xFF);
+            if (rand() % 64 == 0) { //Corrupted in transit
+                unsigned char damaged[2 + FRAME_OVERHEAD];
+                packFrame(FRAME_THRUST_COMMAND, payload, 2, damaged);
+                damaged[5] ^= 0x5A;
+                fwrite(damaged, 1, sizeof(damaged), out);
+            } else {
+                writeFrame(out, FRAME_THRUST_COMMAND, payload, 2);
+            }
+        } else {
+            payload[0] = (unsigned char) (rand() & 1);
+            writeFrame(out, FRAME_SET_MODE, payload, 1);
+        }
+    }
+}
+
+//Takes every complete frame out of the ring and counts it, a command only when its payload has the length it needs
+void parseFrames(FrameRing *ring, ReplayCounts *counts) {
+    FrameView frame;
+    while (frameNext(ring, &frame)) {
+        if (frame.type == FRAME_THRUST_COMMAND && frame.length == 2) {
+            counts->thrustCommands++;
+            counts->checksum += frameByte(&frame, 0) << 8 | frameByte(&frame, 1);
+        } else if (frame.type == FRAME_SET_MODE && frame.length == 1) {
+            counts->modeChanges++;
+            counts->checksum += frameByte(&frame, 0);
+        } else {
+            counts->otherFrames++;
+        }
+        frameRelease(ring, &frame);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (!crcSelfTest()) {
+        fprintf(stderr, "CRC self test failed\n");
+        return 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "-g") == 0) {
+        generate(stdout, atol(argv[2]));
+        return 0;
+    }
+    FILE *in = stdin;
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+    } else if (argc > 2) {
+        fprintf(stderr, "usage: %s [file] | -g <frames>\n", argv[0]);
+        return 1;
+    }
+
+    static FrameRing ring;
+    unsigned char chunk[READ_CHUNK];
+    unsigned long long bytes = 0;
+    ReplayCounts counts = {0, 0, 0, 0};
+    double start = seconds();
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        bytes += got;
+        for (size_t i = 0; i < got; i++) {
+            //Parse whenever the ring fills up, like the satellite does between passes
+            if (frameRingUsed(&ring) == FRAME_RING_SIZE - 1) {
+                parseFrames(&ring, &counts);
+                if (frameRingUsed(&ring) == FRAME_RING_SIZE - 1) { //Still full, a partial frame is stuck
+                    ring.tail = (unsigned char) ((ring.tail + 1) & FRAME_RING_MASK);
+                    ring.overflows++;
+                }
+            }
+            frameRingPut(&ring, chunk[i]);
+        }
+    }
+    parseFrames(&ring, &counts);
+    double elapsed = seconds() - start;
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    printf("bytes %llu frames %lu (thrust %lu, mode %lu, other %lu)\n", bytes, ring.frames, counts.thrustCommands,
+           counts.modeChanges, counts.otherFrames);
+    printf("dropped bytes %u crc errors %u overflows %u payload checksum %lu\n", ring.droppedBytes, ring.crcErrors,
+           ring.overflows, counts.checksum);
+    if (elapsed > 0) {
+        printf("%.3f s, %.1f MB/s, %.0f frames/s\n", elapsed, bytes / elapsed / 1e6, ring.frames / elapsed);
+    }
+    return 0;
+}